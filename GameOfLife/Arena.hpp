@@ -0,0 +1,266 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+// dedicated memory for the chunked universe and the step kernels
+// ChunkPool hands out fixed size blocks from size-classed free lists carved out of big slabs,
+// so creating and destroying chunks at the frontier never touches the general heap
+// ScratchArena is a bump allocator for per-generation temporaries, reset() throws it all away in O(1)
+
+struct ArenaStats
+{
+	// pool
+	uint64_t blockAllocs = 0;
+	uint64_t blockFrees = 0;
+	uint64_t liveBlocks = 0;
+	uint64_t slabs = 0;
+	uint64_t poolBytesReserved = 0;
+	uint64_t oversizeAllocs = 0; // requests bigger than the largest size class, passed on to operator new
+
+	// scratch
+	uint64_t scratchAllocs = 0;
+	uint64_t scratchResets = 0;
+	uint64_t scratchBytesInUse = 0;
+	uint64_t scratchBytesPeak = 0;
+	uint64_t scratchBytesReserved = 0;
+};
+
+struct ChunkPool
+{
+	static constexpr size_t minClassBytes = 64; // one cache line, also the block alignment
+	static constexpr size_t linearClasses = 16; // 64 byte steps up to 1 KiB, so odd sized records don't round up to a power of two
+	static constexpr size_t numClasses = linearClasses + 6; // then powers of two up to 64 KiB
+	static constexpr size_t maxClassBytes = (minClassBytes * linearClasses) << (numClasses - linearClasses);
+	static constexpr size_t slabBytes = 1u << 20;
+
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	FreeBlock* freeLists[numClasses] = {};
+	std::vector<void*> slabList;
+	ArenaStats& stats;
+
+	ChunkPool(ArenaStats& stats) : stats(stats)
+	{
+	}
+
+	~ChunkPool()
+	{
+		for (void* slab : slabList)
+			::operator delete(slab, std::align_val_t(minClassBytes));
+	}
+
+	ChunkPool(const ChunkPool&) = delete;
+	ChunkPool& operator=(const ChunkPool&) = delete;
+
+	static size_t classBytes(size_t index)
+	{
+		if (index < linearClasses)
+			return (index + 1) * minClassBytes;
+		return (minClassBytes * linearClasses) << (index - linearClasses + 1);
+	}
+
+	static size_t sizeClass(size_t bytes)
+	{
+		if (bytes <= minClassBytes * linearClasses)
+			return bytes == 0 ? 0 : (bytes - 1) / minClassBytes;
+
+		size_t index = linearClasses;
+		while (classBytes(index) < bytes)
+			index++;
+		return index;
+	}
+
+	void* allocate(size_t bytes)
+	{
+		if (bytes > maxClassBytes)
+		{
+			stats.oversizeAllocs++;
+			return ::operator new(bytes, std::align_val_t(minClassBytes));
+		}
+
+		size_t index = sizeClass(bytes);
+		if (!freeLists[index])
+			refill(index);
+
+		FreeBlock* block = freeLists[index];
+		freeLists[index] = block->next;
+
+		stats.blockAllocs++;
+		stats.liveBlocks++;
+		return block;
+	}
+
+	void deallocate(void* ptr, size_t bytes)
+	{
+		if (!ptr) return;
+		if (bytes > maxClassBytes)
+		{
+			::operator delete(ptr, std::align_val_t(minClassBytes));
+			return;
+		}
+
+		size_t index = sizeClass(bytes);
+		FreeBlock* block = static_cast<FreeBlock*>(ptr);
+		block->next = freeLists[index];
+		freeLists[index] = block;
+
+		stats.blockFrees++;
+		stats.liveBlocks--;
+	}
+
+	// carves a new slab into blocks of one size class
+	void refill(size_t index)
+	{
+		size_t blockBytes = classBytes(index);
+		char* slab = static_cast<char*>(::operator new(slabBytes, std::align_val_t(minClassBytes)));
+		slabList.push_back(slab);
+
+		stats.slabs++;
+		stats.poolBytesReserved += slabBytes;
+
+		for (size_t offset = 0; offset + blockBytes <= slabBytes; offset += blockBytes)
+		{
+			FreeBlock* block = reinterpret_cast<FreeBlock*>(slab + offset);
+			block->next = freeLists[index];
+			freeLists[index] = block;
+		}
+	}
+};
+
+struct ScratchArena
+{
+	static constexpr size_t firstBlockBytes = 256u << 10;
+
+	struct Block
+	{
+		char* data;
+		size_t size;
+	};
+
+	std::vector<Block> blocks;
+	size_t current = 0; // block currently being bumped
+	size_t offset = 0; // bump position inside the current block
+	size_t bytesInUse = 0;
+	ArenaStats& stats;
+
+	ScratchArena(ArenaStats& stats) : stats(stats)
+	{
+	}
+
+	~ScratchArena()
+	{
+		for (Block& block : blocks)
+			::operator delete(block.data, std::align_val_t(alignof(std::max_align_t)));
+	}
+
+	ScratchArena(const ScratchArena&) = delete;
+	ScratchArena& operator=(const ScratchArena&) = delete;
+
+	// align is a power of two, any size (the blocks are only max_align_t aligned, the address is what's aligned)
+	void* allocate(size_t bytes, size_t align = alignof(std::max_align_t))
+	{
+		if (align == 0 || (align & (align - 1)) != 0)
+			throw std::invalid_argument("ScratchArena: alignment must be a power of two");
+
+		while (true)
+		{
+			if (current < blocks.size())
+			{
+				Block& block = blocks[current];
+				uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+				size_t aligned = static_cast<size_t>(((base + offset + align - 1) & ~static_cast<uintptr_t>(align - 1)) - base);
+				if (aligned + bytes <= block.size)
+				{
+					offset = aligned + bytes;
+					bytesInUse += bytes;
+
+					stats.scratchAllocs++;
+					stats.scratchBytesInUse = bytesInUse;
+					if (bytesInUse > stats.scratchBytesPeak) stats.scratchBytesPeak = bytesInUse;
+					return block.data + aligned;
+				}
+				if (current + 1 < blocks.size())
+				{
+					current++;
+					offset = 0;
+					continue;
+				}
+			}
+			grow(bytes + align);
+		}
+	}
+
+	template <typename T>
+	T* allocateArray(size_t count)
+	{
+		return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+	}
+
+	// everything handed out since the last reset is gone, the blocks are kept for the next generation
+	void reset()
+	{
+		current = 0;
+		offset = 0;
+		bytesInUse = 0;
+		stats.scratchResets++;
+		stats.scratchBytesInUse = 0;
+	}
+
+	void grow(size_t atLeast)
+	{
+		size_t size = blocks.empty() ? firstBlockBytes : blocks.back().size * 2;
+		while (size < atLeast) size *= 2;
+
+		char* data = static_cast<char*>(::operator new(size, std::align_val_t(alignof(std::max_align_t))));
+		blocks.push_back({ data, size });
+		current = blocks.size() - 1;
+		offset = 0;
+		stats.scratchBytesReserved += size;
+	}
+};
+
+// lets std containers (e.g. the chunk map) take their nodes from a ChunkPool
+template <typename T>
+struct ArenaAllocator
+{
+	using value_type = T;
+
+	ChunkPool* pool;
+
+	ArenaAllocator(ChunkPool* pool) : pool(pool)
+	{
+	}
+
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : pool(other.pool)
+	{
+	}
+
+	T* allocate(size_t count)
+	{
+		return static_cast<T*>(pool->allocate(count * sizeof(T)));
+	}
+
+	void deallocate(T* ptr, size_t count)
+	{
+		pool->deallocate(ptr, count * sizeof(T));
+	}
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const
+	{
+		return pool == other.pool;
+	}
+
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const
+	{
+		return pool != other.pool;
+	}
+};
@@ -0,0 +1,274 @@
+#pragma once
+#include "CellAge.hpp"
+#include "Rule.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <bitset>
+
+// bit-packed step kernel shared by the bit based grid backends
+// one bit per cell, 64 cells per word, bit k of word n is cell x = n * 64 + k
+// padding bits past the board width must stay zero, the kernel keeps them that way
+
+namespace BitKernel
+{
+	inline size_t wordsForWidth(int width)
+	{
+		return (static_cast<size_t>(width) + 63) / 64;
+	}
+
+	// mask of the valid bits in the last word of a row
+	inline uint64_t lastWordMask(int width)
+	{
+		int used = width & 63;
+		return used == 0 ? ~0ull : (1ull << used) - 1;
+	}
+
+	inline int popcount(uint64_t word)
+	{
+		return static_cast<int>(std::bitset<64>(word).count());
+	}
+
+	// index of the lowest / highest set bit, word must not be 0
+	inline int lowestBit(uint64_t word)
+	{
+		return popcount((word & (~word + 1)) - 1);
+	}
+
+	inline int highestBit(uint64_t word)
+	{
+		word |= word >> 1;
+		word |= word >> 2;
+		word |= word >> 4;
+		word |= word >> 8;
+		word |= word >> 16;
+		word |= word >> 32;
+		return popcount(word) - 1;
+	}
+
+	// what a step did, gathered while the engine steps so there's no extra pass over the board, the
+	// bounding box is of the live cells after the step (min > max when there are none)
+	// deaths aren't counted, they are the population before the step + births - population
+	struct StepCounts
+	{
+		uint64_t population = 0;
+		uint64_t births = 0;
+		int64_t minX = INT64_MAX;
+		int64_t minY = INT64_MAX;
+		int64_t maxX = INT64_MIN;
+		int64_t maxY = INT64_MIN;
+
+		// next and previous state of the cells x0 .. x0 + 63 of row y (bit k is cell x0 + k)
+		void add(int64_t x0, int64_t y, uint64_t next, uint64_t previous)
+		{
+			population += popcount(next);
+			births += popcount(next & ~previous);
+			if (next)
+				addLive(y, x0 + lowestBit(next), x0 + highestBit(next));
+		}
+
+		// live cells from first to last somewhere in row y
+		void addLive(int64_t y, int64_t first, int64_t last)
+		{
+			if (first < minX) minX = first;
+			if (last > maxX) maxX = last;
+			if (y < minY) minY = y;
+			if (y > maxY) maxY = y;
+		}
+
+		void merge(const StepCounts& other)
+		{
+			population += other.population;
+			births += other.births;
+			if (other.minX < minX) minX = other.minX;
+			if (other.maxX > maxX) maxX = other.maxX;
+			if (other.minY < minY) minY = other.minY;
+			if (other.maxY > maxY) maxY = other.maxY;
+		}
+	};
+
+	// popcount of many words for a fraction of the cost of popcounting each one: every word is reduced to
+	// per-byte counts (at most 8 each) and those are summed for up to 31 words before folding into total
+	struct ByteCounter
+	{
+		uint64_t total = 0;
+		uint64_t bytes = 0;
+		int words = 0;
+
+		void add(uint64_t x)
+		{
+			x = x - ((x >> 1) & 0x5555555555555555ull);
+			x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+			bytes += (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+			if (++words == 31)
+				fold();
+		}
+
+		uint64_t fold()
+		{
+			uint64_t pairs = (bytes & 0x00ff00ff00ff00ffull) + ((bytes >> 8) & 0x00ff00ff00ff00ffull);
+			total += (pairs * 0x0001000100010001ull) >> 48;
+			bytes = 0;
+			words = 0;
+			return total;
+		}
+	};
+
+	inline bool getBit(const uint64_t* row, int x)
+	{
+		return (row[x >> 6] >> (x & 63)) & 1;
+	}
+
+	inline void setBit(uint64_t* row, int x, bool alive)
+	{
+		uint64_t bit = 1ull << (x & 63);
+		if (alive)
+			row[x >> 6] |= bit;
+		else
+			row[x >> 6] &= ~bit;
+	}
+
+	// west neighbors (cell x - 1) of each cell in word n, wrapping around the row
+	inline uint64_t westOf(const uint64_t* row, size_t n, int width)
+	{
+		uint64_t carry = n == 0 ? static_cast<uint64_t>(getBit(row, width - 1)) : row[n - 1] >> 63;
+		return (row[n] << 1) | carry;
+	}
+
+	// east neighbors (cell x + 1) of each cell in word n, wrapping around the row
+	inline uint64_t eastOf(const uint64_t* row, size_t n, size_t words, int width)
+	{
+		if (n + 1 == words)
+			return (row[n] >> 1) | ((row[0] & 1ull) << ((width - 1) & 63));
+		return (row[n] >> 1) | (row[n + 1] << 63);
+	}
+
+	// bit-sliced counter, s2 sticks once the count reaches 4 which is all b3/s23 needs
+	inline void addNeighbor(uint64_t x, uint64_t& s0, uint64_t& s1, uint64_t& s2)
+	{
+		uint64_t c0 = s0 & x;
+		s0 ^= x;
+		uint64_t c1 = s1 & c0;
+		s1 ^= c0;
+		s2 |= c1;
+	}
+
+	// next state of one word of cells given the neighbor words already shifted into place
+	// (west/east words hold each cell's west/east neighbor at the cell's own bit position)
+	inline uint64_t nextWord(uint64_t upWest, uint64_t up, uint64_t upEast,
+		uint64_t midWest, uint64_t mid, uint64_t midEast,
+		uint64_t downWest, uint64_t down, uint64_t downEast)
+	{
+		uint64_t s0 = 0, s1 = 0, s2 = 0;
+
+		addNeighbor(upWest, s0, s1, s2);
+		addNeighbor(up, s0, s1, s2);
+		addNeighbor(upEast, s0, s1, s2);
+		addNeighbor(midWest, s0, s1, s2);
+		addNeighbor(midEast, s0, s1, s2);
+		addNeighbor(downWest, s0, s1, s2);
+		addNeighbor(down, s0, s1, s2);
+		addNeighbor(downEast, s0, s1, s2);
+
+		// alive next generation with exactly 3 neighbors, or 2 neighbors if already alive
+		return ~s2 & s1 & (s0 | mid);
+	}
+
+	// full 4 bit counter for rules that care about counts above 3
+	inline void addNeighbor(uint64_t x, uint64_t& s0, uint64_t& s1, uint64_t& s2, uint64_t& s3)
+	{
+		uint64_t c0 = s0 & x;
+		s0 ^= x;
+		uint64_t c1 = s1 & c0;
+		s1 ^= c0;
+		uint64_t c2 = s2 & c1;
+		s2 ^= c1;
+		s3 |= c2;
+	}
+
+	// same as above for any life-like rule, b3/s23 takes the short path
+	inline uint64_t nextWord(const Rule& rule, uint64_t upWest, uint64_t up, uint64_t upEast,
+		uint64_t midWest, uint64_t mid, uint64_t midEast,
+		uint64_t downWest, uint64_t down, uint64_t downEast)
+	{
+		if (rule.isConway())
+			return nextWord(upWest, up, upEast, midWest, mid, midEast, downWest, down, downEast);
+
+		uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+
+		addNeighbor(upWest, s0, s1, s2, s3);
+		addNeighbor(up, s0, s1, s2, s3);
+		addNeighbor(upEast, s0, s1, s2, s3);
+		addNeighbor(midWest, s0, s1, s2, s3);
+		addNeighbor(midEast, s0, s1, s2, s3);
+		addNeighbor(downWest, s0, s1, s2, s3);
+		addNeighbor(down, s0, s1, s2, s3);
+		addNeighbor(downEast, s0, s1, s2, s3);
+
+		// or together the cells whose count is in the birth / survival set
+		uint64_t born = 0, kept = 0;
+		for (int n = 0; n <= 8; n++)
+		{
+			if (!rule.births(n) && !rule.survives(n)) continue;
+			uint64_t count = ((n & 1) ? s0 : ~s0) & ((n & 2) ? s1 : ~s1) & ((n & 4) ? s2 : ~s2) & ((n & 8) ? s3 : ~s3);
+			if (rule.births(n)) born |= count;
+			if (rule.survives(n)) kept |= count;
+		}
+		return (~mid & born) | (mid & kept);
+	}
+
+	// adds row y (next) that was row previous a step ago to counts, in a pass of its own over rows that are
+	// still in cache so the step loop stays as it is
+	inline void countRow(const uint64_t* next, const uint64_t* previous, size_t words, StepCounts& counts, int64_t y)
+	{
+		ByteCounter population, births;
+		size_t first = words, last = 0;
+		for (size_t n = 0; n < words; n++)
+		{
+			population.add(next[n]);
+			births.add(next[n] & ~previous[n]);
+			if (next[n])
+			{
+				if (first == words) first = n;
+				last = n;
+			}
+		}
+		counts.population += population.fold();
+		counts.births += births.fold();
+		if (first < words)
+			counts.addLive(y, static_cast<int64_t>(first) * 64 + lowestBit(next[first]), static_cast<int64_t>(last) * 64 + highestBit(next[last]));
+	}
+
+	// computes the next state of one row from the rows above, at and below it
+	// ages (optional) is the row's CellAge bytes, 64 per word, aged in the same pass
+	// counts (optional) gets what the step did to the row, y is the row for its bounding box
+	inline void stepRow(const uint64_t* up, const uint64_t* mid, const uint64_t* down, uint64_t* out, size_t words, int width, const Rule& rule = Rule(),
+		uint8_t* ages = nullptr, StepCounts* counts = nullptr, int64_t y = 0)
+	{
+		for (size_t n = 0; n < words; n++)
+		{
+			uint64_t next = nextWord(rule, westOf(up, n, width), up[n], eastOf(up, n, words, width),
+				westOf(mid, n, width), mid[n], eastOf(mid, n, words, width),
+				westOf(down, n, width), down[n], eastOf(down, n, words, width));
+			if (n + 1 == words)
+				next &= lastWordMask(width);
+			out[n] = next;
+			if (ages)
+				CellAge::ageWord(ages + n * 64, next ^ mid[n]);
+		}
+		if (counts)
+			countRow(out, mid, words, *counts, y);
+	}
+
+	// steps rows [rowBegin, rowEnd) of a wrap-around board, rows are `stride` words apart
+	inline void stepRows(const uint64_t* src, uint64_t* dst, int width, int height, size_t stride, int rowBegin, int rowEnd, const Rule& rule = Rule(),
+		StepCounts* counts = nullptr)
+	{
+		size_t words = wordsForWidth(width);
+		for (int y = rowBegin; y < rowEnd; y++)
+		{
+			int yUp = (y + height - 1) % height;
+			int yDown = (y + 1) % height;
+			stepRow(src + yUp * stride, src + y * stride, src + yDown * stride, dst + y * stride, words, width, rule, nullptr, counts, y);
+		}
+	}
+}
@@ -0,0 +1,251 @@
+#pragma once
+#include "Checkpoint.hpp"
+#include "History.hpp"
+#include "MappedGrid.hpp"
+#include "ParallelGrid.hpp"
+#include "PatternIO.hpp"
+#include "RunOptions.hpp"
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+// puts the starting board asked for on the command line onto an engine, Grid or one of the bit backends
+// anything with rule, setAlive(x, y) and setDead(x, y) works, x is the column like Grid's i
+// returns false if the options don't ask for a particular start
+// a pattern file's name and comments go in header (when given) so saving the board can keep them
+
+// where a width x height pattern's top left goes, centered unless --at was given
+inline void patternOrigin(int64_t width, int64_t height, const RunOptions& options, bool bounded, int64_t& x0, int64_t& y0)
+{
+	x0 = options.patternPlaced ? options.patternX : (options.width - width) / 2;
+	y0 = options.patternPlaced ? options.patternY : (options.height - height) / 2;
+
+	if (bounded && (x0 < 0 || y0 < 0 || x0 + width > options.width || y0 + height > options.height))
+		throw std::invalid_argument("pattern " + options.patternPath + " doesn't fit on the board at that position");
+}
+
+template <typename Engine>
+void placePattern(Engine& engine, const PatternIO::Pattern& pattern, const RunOptions& options, bool bounded, PatternIO::Pattern* header)
+{
+	if (header)
+	{
+		header->name = pattern.name;
+		header->comments = pattern.comments;
+	}
+
+	int64_t x0, y0;
+	patternOrigin(pattern.width, pattern.height, options, bounded, x0, y0);
+
+	for (const auto& cell : pattern.cells)
+		engine.setAlive(x0 + cell.first, y0 + cell.second);
+}
+
+// rle files are decoded straight onto the engine a run at a time, the cells never sit in a list in between
+// the file's rule is used unless --rule was given
+template <typename Engine>
+void placeRle(Engine& engine, const RunOptions& options, bool bounded, PatternIO::Pattern* header)
+{
+	std::ifstream in(options.patternPath, std::ios::binary);
+	if (!in)
+		throw std::runtime_error("PatternIO: can't open " + options.patternPath);
+
+	PatternIO::RleReader reader(in);
+	if (reader.header.hasRule && !options.ruleGiven)
+		engine.rule = reader.header.rule;
+	if (header)
+		*header = reader.header;
+
+	int64_t x0, y0;
+	patternOrigin(reader.header.width, reader.header.height, options, bounded, x0, y0);
+	reader.readCells([&](int64_t x, int64_t y, int64_t length)
+	{
+		for (int64_t k = 0; k < length; k++)
+			engine.setAlive(x0 + x + k, y0 + y);
+	});
+}
+
+// same seed and density give the same board on every engine
+template <typename Engine>
+void fillRandom(Engine& engine, const RunOptions& options)
+{
+	std::mt19937_64 gen(options.seed);
+	std::uniform_real_distribution<double> dis(0.0, 1.0);
+	for (int y = 0; y < options.height; y++)
+	{
+		for (int x = 0; x < options.width; x++)
+		{
+			if (dis(gen) < options.density)
+				engine.setAlive(x, y);
+			else
+				engine.setDead(x, y);
+		}
+	}
+}
+
+// macrocell files stay a shared tree until the runs of live cells are written onto the engine
+// one we saved (#P) goes back where it was on the board unless --at says otherwise, others are centered
+template <typename Engine>
+void placeMacrocell(Engine& engine, const RunOptions& options, bool bounded, PatternIO::Pattern* header)
+{
+	std::ifstream in(options.patternPath, std::ios::binary);
+	if (!in)
+		throw std::runtime_error("PatternIO: can't open " + options.patternPath);
+
+	PatternIO::Macrocell file = PatternIO::readMacrocell(in);
+	if (file.header.hasRule && !options.ruleGiven)
+		engine.rule = file.header.rule;
+	if (header)
+		*header = file.header;
+
+	int64_t x0, y0;
+	if (file.hasPosition && !options.patternPlaced)
+	{
+		x0 = file.positionX + file.minX;
+		y0 = file.positionY + file.minY;
+		if (bounded && file.header.width > 0 && (x0 < 0 || y0 < 0 || x0 + file.header.width > options.width || y0 + file.header.height > options.height))
+			throw std::invalid_argument("pattern " + options.patternPath + " was saved from a bigger board, it doesn't fit at its position (give --at to move it)");
+	}
+	else
+	{
+		patternOrigin(file.header.width, file.header.height, options, bounded, x0, y0);
+	}
+	file.forEachRun([&](int64_t x, int64_t y, int64_t length)
+	{
+		for (int64_t k = 0; k < length; k++)
+			engine.setAlive(x0 + x + k, y0 + y);
+	});
+}
+
+// bit-packed rows (rowOf(y)) copied cell by cell onto engines that keep their board some other way
+template <typename Engine, typename RowOf>
+void placeRows(Engine& engine, int width, int height, int64_t x0, int64_t y0, RowOf rowOf)
+{
+	size_t words = BitKernel::wordsForWidth(width);
+	for (int y = 0; y < height; y++)
+	{
+		const uint64_t* row = rowOf(y);
+		for (size_t n = 0; n < words; n++)
+		{
+			for (uint64_t bits = row[n]; bits; bits &= bits - 1)
+			{
+				int64_t x = static_cast<int64_t>(n * 64) + BitKernel::popcount((bits & (~bits + 1)) - 1);
+				engine.setAlive(x0 + x, y0 + y);
+			}
+		}
+	}
+}
+
+// a bounded board's checkpoint rows go at 0, 0 of the board, only the chunked universe (unbounded) puts
+// them back at the origin it saved, which is wherever its live cells were
+inline void checkResumeFits(const Checkpoint::Header& header, int width, int height, const std::string& path)
+{
+	if (header.width > width || header.height > height)
+		throw std::invalid_argument("checkpoint " + path + " is " + std::to_string(header.width) + "x" + std::to_string(header.height)
+			+ ", bigger than the " + std::to_string(width) + "x" + std::to_string(height) + " board");
+}
+
+template <typename Engine>
+void resumeBoard(Engine& engine, const RunOptions& options, bool bounded)
+{
+	Checkpoint::Mapping mapping(options.resumePath);
+	const Checkpoint::Header& header = mapping.header();
+	engine.rule = Checkpoint::ruleOf(header);
+	if (bounded)
+		checkResumeFits(header, options.width, options.height, options.resumePath);
+	int64_t x0 = bounded ? 0 : header.originX;
+	int64_t y0 = bounded ? 0 : header.originY;
+	placeRows(engine, header.width, header.height, x0, y0, [&](int y) { return mapping.row(y); });
+}
+
+// the parallel engine steps on top of the mapped checkpoint, nothing is read up front
+// adopt only takes a checkpoint of exactly its size, at 0, 0
+inline void resumeBoard(ParallelGrid& engine, const RunOptions& options, bool)
+{
+	engine.adopt(std::make_unique<Checkpoint::Mapping>(options.resumePath));
+}
+
+inline void resumeBoard(MappedGrid& engine, const RunOptions& options, bool)
+{
+	Checkpoint::Mapping mapping(options.resumePath);
+	const Checkpoint::Header& header = mapping.header();
+	if (header.width != engine.w || header.height != engine.h)
+		throw std::invalid_argument("MappedGrid: checkpoint " + options.resumePath + " is for a different board size");
+	engine.rule = Checkpoint::ruleOf(header);
+	for (int y = 0; y < engine.h; y++)
+		std::memcpy(engine.row(y), mapping.row(y), engine.wordsPerRow * sizeof(uint64_t));
+}
+
+// a generation of a recorded history, decoded from its nearest keyframe
+template <typename Engine>
+void replayBoard(Engine& engine, const RunOptions& options)
+{
+	History::Reader history(options.replayPath);
+	const BitFrame& frame = history.seek(options.replayGeneration);
+	engine.rule = history.rule();
+	placeRows(engine, frame.width, frame.height, 0, 0, [&](int y) { return frame.row(y); });
+}
+
+inline void replayBoard(ParallelGrid& engine, const RunOptions& options)
+{
+	History::Reader history(options.replayPath);
+	const BitFrame& frame = history.seek(options.replayGeneration);
+	engine.rule = history.rule();
+	engine.generation = options.replayGeneration;
+	for (int y = 0; y < engine.h; y++)
+		std::memcpy(engine.row(y), frame.row(y), frame.stride * sizeof(uint64_t));
+}
+
+inline void replayBoard(MappedGrid& engine, const RunOptions& options)
+{
+	History::Reader history(options.replayPath);
+	const BitFrame& frame = history.seek(options.replayGeneration);
+	engine.rule = history.rule();
+	for (int y = 0; y < engine.h; y++)
+		std::memcpy(engine.row(y), frame.row(y), frame.stride * sizeof(uint64_t));
+}
+
+template <typename Engine>
+bool setUpBoard(Engine& engine, const RunOptions& options, bool bounded = true, PatternIO::Pattern* header = nullptr)
+{
+	engine.rule = options.rule;
+
+	if (!options.resumePath.empty())
+	{
+		resumeBoard(engine, options, bounded);
+		if (options.ruleGiven)
+			engine.rule = options.rule;
+		return true;
+	}
+	if (!options.replayPath.empty())
+	{
+		replayBoard(engine, options);
+		if (options.ruleGiven)
+			engine.rule = options.rule;
+		return true;
+	}
+
+	if (!options.patternPath.empty() && PatternIO::hasExtension(options.patternPath, ".rle"))
+	{
+		placeRle(engine, options, bounded, header);
+		return true;
+	}
+	if (!options.patternPath.empty() && PatternIO::hasExtension(options.patternPath, ".mc"))
+	{
+		placeMacrocell(engine, options, bounded, header);
+		return true;
+	}
+	if (!options.patternPath.empty())
+	{
+		placePattern(engine, PatternIO::load(options.patternPath), options, bounded, header);
+		return true;
+	}
+	if (options.seeded)
+	{
+		fillRandom(engine, options);
+		return true;
+	}
+	return false;
+}
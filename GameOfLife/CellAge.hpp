@@ -0,0 +1,113 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+// per-cell age, the number of generations since the cell last changed state, one byte per cell
+// that sticks at maxAge, so a board that has settled down costs nothing extra to draw
+// the engines keep it up to date while they step, the renderers turn it into a heatmap through Palette
+
+namespace CellAge
+{
+	const uint8_t maxAge = 255;
+
+	inline uint8_t older(uint8_t age)
+	{
+		return age == maxAge ? age : static_cast<uint8_t>(age + 1);
+	}
+
+	// +1 on each of the 8 ages packed in a word, bytes already at maxAge stay there
+	inline uint64_t older(uint64_t ages)
+	{
+		const uint64_t low7 = 0x7f7f7f7f7f7f7f7full;
+		const uint64_t ones = 0x0101010101010101ull;
+
+		// high bit of every byte that is 0xff, found as the zero bytes of ~ages
+		uint64_t inverted = ~ages;
+		uint64_t saturated = ~(((inverted & low7) + low7) | inverted | low7);
+		return ages + ((~saturated >> 7) & ones);
+	}
+
+	// bit k of bits -> byte k of the result set to 0xff
+	inline uint64_t spreadBits(uint8_t bits)
+	{
+		static const struct Table
+		{
+			uint64_t masks[256];
+			Table()
+			{
+				for (int bitsIn = 0; bitsIn < 256; bitsIn++)
+				{
+					masks[bitsIn] = 0;
+					for (int k = 0; k < 8; k++)
+						if ((bitsIn >> k) & 1)
+							masks[bitsIn] |= 0xffull << (k * 8);
+				}
+			}
+		} table;
+		return table.masks[bits];
+	}
+
+	// ages of the 64 cells of one kernel word, changed has a bit set for every cell that flipped
+	// eight cells at a time, the byte order assumes a little endian machine like the rest of the bit code
+	inline void ageWord(uint8_t* ages, uint64_t changed)
+	{
+		for (int b = 0; b < 8; b++)
+		{
+			uint64_t packed;
+			std::memcpy(&packed, ages + b * 8, 8);
+			packed = older(packed) & ~spreadBits(static_cast<uint8_t>(changed >> (b * 8)));
+			std::memcpy(ages + b * 8, &packed, 8);
+		}
+	}
+
+	// age -> rgb lookup for the heatmap, alive cells go from white hot when just born through orange and
+	// red to a deep blue once they've been stable for a while, dead cells glow for a few generations
+	// after dying and fade out to black
+	struct Palette
+	{
+		uint8_t alive[256][3];
+		uint8_t dead[256][3];
+
+		struct Stop
+		{
+			int age;
+			uint8_t r, g, b;
+		};
+
+		Palette()
+		{
+			static const Stop aliveStops[] = { { 0, 255, 255, 210 }, { 4, 255, 205, 50 }, { 16, 240, 100, 20 }, { 64, 175, 30, 95 }, { 255, 55, 45, 160 } };
+			static const Stop deadStops[] = { { 0, 130, 50, 20 }, { 8, 60, 18, 35 }, { 24, 0, 0, 0 }, { 255, 0, 0, 0 } };
+			fill(alive, aliveStops, sizeof(aliveStops) / sizeof(Stop));
+			fill(dead, deadStops, sizeof(deadStops) / sizeof(Stop));
+		}
+
+		// linear blend between neighboring stops
+		static void fill(uint8_t (&colors)[256][3], const Stop* stops, size_t count)
+		{
+			for (size_t s = 0; s + 1 < count; s++)
+			{
+				const Stop& a = stops[s];
+				const Stop& b = stops[s + 1];
+				for (int age = a.age; age <= b.age; age++)
+				{
+					float t = static_cast<float>(age - a.age) / (b.age - a.age);
+					colors[age][0] = static_cast<uint8_t>(a.r + (b.r - a.r) * t + 0.5f);
+					colors[age][1] = static_cast<uint8_t>(a.g + (b.g - a.g) * t + 0.5f);
+					colors[age][2] = static_cast<uint8_t>(a.b + (b.b - a.b) * t + 0.5f);
+				}
+			}
+		}
+
+		const uint8_t* color(bool isAlive, uint8_t age) const
+		{
+			return isAlive ? alive[age] : dead[age];
+		}
+
+		static const Palette& get()
+		{
+			static const Palette palette;
+			return palette;
+		}
+	};
+}
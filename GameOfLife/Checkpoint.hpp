@@ -0,0 +1,365 @@
+#pragma once
+#include "BitKernel.hpp"
+#include "Rule.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+// binary board checkpoints for resuming long runs
+// file layout: one page of Header, then the board's rows bit-packed like BitKernel with every row padded
+// to a multiple of 64 bytes, the same row layout ParallelGrid keeps in memory
+// so saving writes the engine's rows straight out, and loading maps the file and lets the engine step
+// on top of the mapping (copy on write) instead of parsing or copying anything
+// integers are stored little endian, which is what every machine we build for is
+
+namespace Checkpoint
+{
+	const uint32_t fileVersion = 1;
+	const size_t headerBytes = 4096;
+	const size_t rowAlignWords = 8;
+
+	struct Header
+	{
+		char magic[4]; // "GOLC"
+		uint32_t version;
+		uint32_t headerBytes; // rows start here
+		uint32_t flags; // none yet
+		int32_t width;
+		int32_t height;
+		int64_t originX; // cell coordinates of the top left, only the chunked universe isn't at 0, 0
+		int64_t originY;
+		uint64_t wordsPerRow; // including the padding
+		uint64_t generation;
+		uint16_t birth; // Rule masks
+		uint16_t survival;
+		char engine[16]; // engine that wrote it, zero padded
+		uint64_t planeBytes;
+	};
+
+	inline size_t wordsPerRow(int width)
+	{
+		return (BitKernel::wordsForWidth(width) + rowAlignWords - 1) / rowAlignWords * rowAlignWords;
+	}
+
+	inline Header makeHeader(int width, int height, const Rule& rule, uint64_t generation, const std::string& engine)
+	{
+		Header header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, "GOLC", 4);
+		header.version = fileVersion;
+		header.headerBytes = static_cast<uint32_t>(headerBytes);
+		header.width = width;
+		header.height = height;
+		header.wordsPerRow = wordsPerRow(width);
+		header.generation = generation;
+		header.birth = rule.birth;
+		header.survival = rule.survival;
+		std::strncpy(header.engine, engine.c_str(), sizeof(header.engine) - 1);
+		header.planeBytes = header.wordsPerRow * sizeof(uint64_t) * static_cast<uint64_t>(height);
+		return header;
+	}
+
+	inline Rule ruleOf(const Header& header)
+	{
+		Rule rule;
+		rule.birth = header.birth;
+		rule.survival = header.survival;
+		return rule;
+	}
+
+	inline std::string engineOf(const Header& header)
+	{
+		return std::string(header.engine, strnlen(header.engine, sizeof(header.engine)));
+	}
+
+	inline void validate(const Header& header, uint64_t fileBytes, const std::string& path)
+	{
+		if (std::memcmp(header.magic, "GOLC", 4) != 0)
+			throw std::runtime_error("Checkpoint: " + path + " is not a checkpoint");
+		if (header.version != fileVersion)
+			throw std::runtime_error("Checkpoint: " + path + " is version " + std::to_string(header.version) + ", this build reads version " + std::to_string(fileVersion));
+		if (header.width <= 0 || header.height <= 0 || header.headerBytes != headerBytes || header.wordsPerRow != wordsPerRow(header.width)
+			|| header.planeBytes != header.wordsPerRow * sizeof(uint64_t) * static_cast<uint64_t>(header.height)
+			|| fileBytes < header.headerBytes + header.planeBytes)
+			throw std::runtime_error("Checkpoint: " + path + " is damaged or cut short");
+	}
+
+	// checkpoint file mapped copy-on-write, rows can be stepped in place and the file never changes
+	struct Mapping
+	{
+		std::string path;
+		unsigned char* base = nullptr;
+		size_t bytes = 0;
+#ifdef _WIN32
+		HANDLE fileHandle = INVALID_HANDLE_VALUE;
+		HANDLE mappingHandle = nullptr;
+#else
+		int fd = -1;
+#endif
+
+		Mapping(const std::string& filePath) : path(filePath)
+		{
+#ifdef _WIN32
+			fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (fileHandle == INVALID_HANDLE_VALUE)
+				throw std::runtime_error("Checkpoint: can't open " + path);
+			LARGE_INTEGER size;
+			GetFileSizeEx(fileHandle, &size);
+			bytes = static_cast<size_t>(size.QuadPart);
+			if (bytes < sizeof(Header))
+			{
+				close();
+				throw std::runtime_error("Checkpoint: " + path + " is not a checkpoint");
+			}
+			mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+			if (mappingHandle)
+				base = static_cast<unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_COPY, 0, 0, bytes));
+#else
+			fd = open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+				throw std::runtime_error("Checkpoint: can't open " + path);
+			struct stat info;
+			fstat(fd, &info);
+			bytes = static_cast<size_t>(info.st_size);
+			if (bytes < sizeof(Header))
+			{
+				close();
+				throw std::runtime_error("Checkpoint: " + path + " is not a checkpoint");
+			}
+			void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+			if (mapped != MAP_FAILED)
+				base = static_cast<unsigned char*>(mapped);
+#endif
+			if (!base)
+			{
+				close();
+				throw std::runtime_error("Checkpoint: can't map " + path);
+			}
+
+			try
+			{
+				validate(header(), bytes, path);
+			}
+			catch (...)
+			{
+				close();
+				throw;
+			}
+		}
+
+		~Mapping()
+		{
+			close();
+		}
+
+		Mapping(const Mapping&) = delete;
+		Mapping& operator=(const Mapping&) = delete;
+
+		const Header& header() const
+		{
+			return *reinterpret_cast<const Header*>(base);
+		}
+
+		uint64_t* row(int y)
+		{
+			return reinterpret_cast<uint64_t*>(base + header().headerBytes) + static_cast<size_t>(y) * header().wordsPerRow;
+		}
+
+		void close()
+		{
+#ifdef _WIN32
+			if (base) UnmapViewOfFile(base);
+			if (mappingHandle) CloseHandle(mappingHandle);
+			if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+			mappingHandle = nullptr;
+			fileHandle = INVALID_HANDLE_VALUE;
+#else
+			if (base) munmap(base, bytes);
+			if (fd >= 0) ::close(fd);
+			fd = -1;
+#endif
+			base = nullptr;
+		}
+	};
+
+	// just the header, for deciding which engine and size to resume with before opening the mapping
+	inline Header readHeader(const std::string& path)
+	{
+		Mapping mapping(path);
+		return mapping.header();
+	}
+
+	// write-only file that only replaces path once everything is on disk, a crash halfway leaves the old
+	// checkpoint alone
+	struct OutputFile
+	{
+		std::string path;
+		std::string temporary;
+#ifdef _WIN32
+		HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+		int fd = -1;
+#endif
+
+		OutputFile(const std::string& filePath) : path(filePath), temporary(filePath + ".partial")
+		{
+#ifdef _WIN32
+			handle = CreateFileA(temporary.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (handle == INVALID_HANDLE_VALUE)
+				throw std::runtime_error("Checkpoint: can't write " + temporary);
+#else
+			fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (fd < 0)
+				throw std::runtime_error("Checkpoint: can't write " + temporary);
+#endif
+		}
+
+		~OutputFile()
+		{
+			if (close())
+				std::remove(temporary.c_str()); // never committed
+		}
+
+		OutputFile(const OutputFile&) = delete;
+		OutputFile& operator=(const OutputFile&) = delete;
+
+		// gathers pieces into as few system calls as possible, nothing is copied
+		struct Piece
+		{
+			const void* data;
+			size_t bytes;
+		};
+
+		void write(const Piece* pieces, size_t count)
+		{
+#ifdef _WIN32
+			for (size_t n = 0; n < count; n++)
+			{
+				const char* data = static_cast<const char*>(pieces[n].data);
+				size_t left = pieces[n].bytes;
+				while (left > 0)
+				{
+					DWORD chunk = left > (1u << 30) ? (1u << 30) : static_cast<DWORD>(left);
+					DWORD written = 0;
+					if (!WriteFile(handle, data, chunk, &written, nullptr) || written == 0)
+						throw std::runtime_error("Checkpoint: writing " + temporary + " failed");
+					data += written;
+					left -= written;
+				}
+			}
+#else
+			std::vector<iovec> vectors;
+			for (size_t n = 0; n < count; n++)
+				if (pieces[n].bytes > 0)
+					vectors.push_back({ const_cast<void*>(pieces[n].data), pieces[n].bytes });
+
+			size_t first = 0;
+			while (first < vectors.size())
+			{
+				int batch = static_cast<int>(vectors.size() - first < IOV_MAX ? vectors.size() - first : IOV_MAX);
+				ssize_t written = ::writev(fd, &vectors[first], batch);
+				if (written < 0)
+				{
+					if (errno == EINTR) continue;
+					throw std::runtime_error("Checkpoint: writing " + temporary + " failed");
+				}
+
+				// skip whatever went out, a short write leaves part of a piece to go again
+				size_t done = static_cast<size_t>(written);
+				while (first < vectors.size() && done >= vectors[first].iov_len)
+					done -= vectors[first++].iov_len;
+				if (first < vectors.size())
+				{
+					vectors[first].iov_base = static_cast<char*>(vectors[first].iov_base) + done;
+					vectors[first].iov_len -= done;
+				}
+			}
+#endif
+		}
+
+		// flushes to disk and moves the file into place
+		void commit()
+		{
+#ifdef _WIN32
+			if (!FlushFileBuffers(handle))
+				throw std::runtime_error("Checkpoint: flushing " + temporary + " failed");
+#else
+			if (fsync(fd) != 0)
+				throw std::runtime_error("Checkpoint: flushing " + temporary + " failed");
+#endif
+			close();
+			std::filesystem::rename(temporary, path);
+		}
+
+		// returns true if something was open
+		bool close()
+		{
+#ifdef _WIN32
+			if (handle == INVALID_HANDLE_VALUE) return false;
+			CloseHandle(handle);
+			handle = INVALID_HANDLE_VALUE;
+#else
+			if (fd < 0) return false;
+			::close(fd);
+			fd = -1;
+#endif
+			return true;
+		}
+	};
+
+	// writes header and rows, rowOf(y) points at a row of at least rowWords words (the rest of the padded row
+	// is written as zeros), rows are handed to the os in batches straight from wherever they live
+	template <typename RowOf>
+	void save(const std::string& path, const Header& header, RowOf rowOf, size_t rowWords)
+	{
+		static const uint64_t zeros[rowAlignWords] = {};
+		if (rowWords > header.wordsPerRow || header.wordsPerRow - rowWords > rowAlignWords)
+			throw std::invalid_argument("Checkpoint: rows don't match the header's width");
+		std::vector<unsigned char> page(headerBytes, 0);
+		std::memcpy(page.data(), &header, sizeof(header));
+
+		OutputFile file(path);
+		OutputFile::Piece first = { page.data(), page.size() };
+		file.write(&first, 1);
+
+		size_t padBytes = (header.wordsPerRow - rowWords) * sizeof(uint64_t);
+		const int rowsPerBatch = 512;
+		std::vector<OutputFile::Piece> pieces;
+		for (int y = 0; y < header.height; y += rowsPerBatch)
+		{
+			pieces.clear();
+			int end = y + rowsPerBatch < header.height ? y + rowsPerBatch : header.height;
+			for (int r = y; r < end; r++)
+			{
+				pieces.push_back({ rowOf(r), rowWords * sizeof(uint64_t) });
+				if (padBytes > 0)
+					pieces.push_back({ zeros, padBytes });
+			}
+			file.write(pieces.data(), pieces.size());
+		}
+		file.commit();
+	}
+}
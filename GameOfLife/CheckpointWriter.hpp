@@ -0,0 +1,207 @@
+#pragma once
+#include "Checkpoint.hpp"
+#include "SoftwareRenderer.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// periodic checkpoints every N generations and/or T seconds that don't stop the simulation
+// the simulation thread only takes a snapshot, a writer thread saves it (Checkpoint::save, atomically
+// replacing the last checkpoint) while the next generations are stepped
+// engines that can freeze their rows (ParallelGrid, MappedGrid) hand them over without copying anything, the rest
+// are copied into a BitFrame first, a memcpy per row for the bit engines
+// one checkpoint is written at a time, one that comes due while the last is still being written waits for
+// it to finish instead of queueing up more snapshots
+
+struct CheckpointWriterOptions
+{
+	std::string path;
+	uint64_t every = 0; // generations between checkpoints, 0 = not by generation
+	double seconds = 0; // wall time between checkpoints, 0 = not by time
+};
+
+struct CheckpointWriter
+{
+	using clock = std::chrono::steady_clock;
+
+	// what the simulation hands over, rows are either someone else's (released through done) or the frame's
+	struct Job
+	{
+		Checkpoint::Header header;
+		std::vector<const uint64_t*> rows;
+		size_t rowWords = 0;
+		BitFrame frame;
+		std::function<void()> done;
+		double snapshotSeconds = 0; // how long the simulation thread was held up
+	};
+
+	// finished checkpoints, picked up by the simulation thread for reporting
+	struct Completed
+	{
+		uint64_t generation;
+		uint64_t bytes;
+		double snapshotSeconds;
+		double writeSeconds;
+	};
+
+	CheckpointWriterOptions options;
+	clock::time_point lastStarted;
+	uint64_t lastGeneration; // of the last checkpoint started, or where the run started
+
+	Job job;
+	bool pending = false; // job is waiting for or being written by the writer
+	std::mutex mutex;
+	std::condition_variable work;
+	std::condition_variable idle;
+	std::thread writer;
+	bool finishing = false;
+	std::string error;
+	std::deque<Completed> completed;
+
+	uint64_t checkpointsWritten = 0;
+	uint64_t bytesWritten = 0;
+	double writeSeconds = 0;
+
+	CheckpointWriter(const CheckpointWriterOptions& opts, uint64_t firstGeneration = 0)
+		: options(opts), lastStarted(clock::now()), lastGeneration(firstGeneration)
+	{
+		writer = std::thread(&CheckpointWriter::writerLoop, this);
+	}
+
+	~CheckpointWriter()
+	{
+		try
+		{
+			finish();
+		}
+		catch (const std::exception&)
+		{
+			// nowhere to report it from a destructor, call finish() first to find out
+		}
+	}
+
+	CheckpointWriter(const CheckpointWriter&) = delete;
+	CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+	// checked every generation, a checkpoint that is due stays due until one could be started
+	bool due(uint64_t generation) const
+	{
+		if (options.every > 0 && generation - lastGeneration >= options.every)
+			return true;
+		return options.seconds > 0 && std::chrono::duration<double>(clock::now() - lastStarted).count() >= options.seconds;
+	}
+
+	// simulation thread, snapshot(job) fills in the header and either rows/rowWords/done or the frame
+	// returns false if the last checkpoint is still being written
+	template <typename Snapshot>
+	bool start(Snapshot snapshot)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (pending || finishing) return false;
+		}
+
+		// the job belongs to this thread until it is pending
+		auto began = clock::now();
+		job.rows.clear();
+		job.rowWords = 0;
+		job.done = nullptr;
+		if (!snapshot(job))
+			return false;
+		job.snapshotSeconds = std::chrono::duration<double>(clock::now() - began).count();
+		lastStarted = began;
+		lastGeneration = job.header.generation;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pending = true;
+		}
+		work.notify_one();
+		return true;
+	}
+
+	// blocks until the checkpoint being written (if any) is on disk
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		idle.wait(lock, [&] { return !pending; });
+	}
+
+	bool takeCompleted(Completed& done)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (completed.empty()) return false;
+		done = completed.front();
+		completed.pop_front();
+		return true;
+	}
+
+	// waits for the last checkpoint and stops the writer, throws if any checkpoint failed
+	void finish()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			finishing = true;
+		}
+		work.notify_all();
+		if (writer.joinable())
+			writer.join();
+
+		if (!error.empty())
+			throw std::runtime_error("CheckpointWriter: " + error);
+	}
+
+	void writerLoop()
+	{
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				work.wait(lock, [&] { return finishing || pending; });
+				if (!pending) return; // finishing and nothing left
+			}
+
+			auto began = clock::now();
+			std::string failure;
+			try
+			{
+				if (job.done)
+					Checkpoint::save(options.path, job.header, [&](int y) { return job.rows[y]; }, job.rowWords);
+				else
+					Checkpoint::save(options.path, job.header, [&](int y) { return job.frame.row(y); }, job.frame.stride);
+			}
+			catch (const std::exception& e)
+			{
+				failure = e.what();
+			}
+			if (job.done)
+				job.done();
+			double seconds = std::chrono::duration<double>(clock::now() - began).count();
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (failure.empty())
+				{
+					uint64_t bytes = job.header.headerBytes + job.header.planeBytes;
+					checkpointsWritten++;
+					bytesWritten += bytes;
+					writeSeconds += seconds;
+					completed.push_back({ job.header.generation, bytes, job.snapshotSeconds, seconds });
+				}
+				else if (error.empty())
+				{
+					error = failure;
+				}
+				pending = false;
+			}
+			idle.notify_all();
+		}
+	}
+};
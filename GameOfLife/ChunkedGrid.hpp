@@ -0,0 +1,445 @@
+#pragma once
+#include "Arena.hpp"
+#include "BitKernel.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+// sparse, unbounded universe made of 64x64 bit-packed chunks
+// only chunks with live cells are stored, update() steps every live chunk plus its 8 neighbors (the frontier)
+// chunks and map nodes come from a ChunkPool, per-generation bookkeeping from a ScratchArena
+// identical chunks share one reference counted instance (hash-consed through an intern table) and are copied
+// on write when edited, all dead chunks aren't stored at all and all alive chunks point at a static flyweight
+// an edited chunk is private and stays out of the intern table until the next update() interns what it stepped,
+// so a board set up (or edited) with many identical chunks only shares them from the first generation on
+
+struct DedupStats
+{
+	uint64_t chunkRefs = 0; // chunks on the board
+	uint64_t storedChunks = 0; // distinct chunk instances actually held in memory
+	uint64_t flyweightRefs = 0; // board chunks pointing at the all alive flyweight
+	uint64_t dedupHits = 0; // times a new chunk was found in the intern table instead of allocated
+	uint64_t cowCopies = 0; // shared chunks copied because an edit diverged them
+	uint64_t residentBytes = 0;
+};
+
+struct ChunkedGrid
+{
+	static constexpr int chunkSize = 64;
+
+	struct Chunk
+	{
+		uint64_t rows[chunkSize]; // bit k of rows[y] is the cell (k, y) inside the chunk
+		uint64_t hash = 0;
+		uint32_t refs = 0;
+		bool interned = false; // in the intern table, contents must not change while it is
+		bool flyweight = false; // static instance, never counted or freed
+	};
+
+	struct ContentHash
+	{
+		size_t operator()(const Chunk* chunk) const
+		{
+			return static_cast<size_t>(chunk->hash);
+		}
+	};
+
+	struct ContentEqual
+	{
+		bool operator()(const Chunk* a, const Chunk* b) const
+		{
+			return a->hash == b->hash && std::memcmp(a->rows, b->rows, sizeof(a->rows)) == 0;
+		}
+	};
+
+	using ChunkMap = std::unordered_map<uint64_t, Chunk*, std::hash<uint64_t>, std::equal_to<uint64_t>,
+		ArenaAllocator<std::pair<const uint64_t, Chunk*>>>;
+	using InternTable = std::unordered_set<Chunk*, ContentHash, ContentEqual, ArenaAllocator<Chunk*>>;
+
+	bool gamePaused = true;
+	uint64_t generation = 0;
+	Rule rule; // must not have b0, an unbounded universe can't light up every empty chunk
+	bool countSteps = false; // fill lastStep with what every step did
+	BitKernel::StepCounts lastStep;
+
+	// declaration order matters, the containers have to be destroyed before the pool they allocate from
+	ArenaStats stats;
+	DedupStats dedup;
+	ChunkPool pool;
+	ScratchArena scratch;
+	InternTable interned;
+	ChunkMap chunks;
+
+	ChunkedGrid() : pool(stats), scratch(stats),
+		interned(0, ContentHash(), ContentEqual(), ArenaAllocator<Chunk*>(&pool)),
+		chunks(0, std::hash<uint64_t>(), std::equal_to<uint64_t>(), ArenaAllocator<std::pair<const uint64_t, Chunk*>>(&pool))
+	{
+	}
+
+	~ChunkedGrid()
+	{
+		clear();
+	}
+
+	ChunkedGrid(const ChunkedGrid&) = delete;
+	ChunkedGrid& operator=(const ChunkedGrid&) = delete;
+
+	static uint64_t chunkKey(int32_t cx, int32_t cy)
+	{
+		return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cy);
+	}
+
+	static int32_t keyX(uint64_t key)
+	{
+		return static_cast<int32_t>(static_cast<uint32_t>(key >> 32));
+	}
+
+	static int32_t keyY(uint64_t key)
+	{
+		return static_cast<int32_t>(static_cast<uint32_t>(key));
+	}
+
+	// floor division so negative coordinates land in the right chunk
+	static int32_t chunkCoord(int64_t cell)
+	{
+		return static_cast<int32_t>(cell >= 0 ? cell / chunkSize : (cell - (chunkSize - 1)) / chunkSize);
+	}
+
+	static int localCoord(int64_t cell)
+	{
+		return static_cast<int>(cell - static_cast<int64_t>(chunkCoord(cell)) * chunkSize);
+	}
+
+	static Chunk makeFlyweight(uint64_t fill)
+	{
+		Chunk chunk;
+		for (int y = 0; y < chunkSize; y++)
+			chunk.rows[y] = fill;
+		chunk.flyweight = true;
+		return chunk;
+	}
+
+	static Chunk& emptyChunk()
+	{
+		static Chunk empty = makeFlyweight(0);
+		return empty;
+	}
+
+	static Chunk& fullChunk()
+	{
+		static Chunk full = makeFlyweight(~0ull);
+		return full;
+	}
+
+	static bool isEmpty(const Chunk& chunk)
+	{
+		uint64_t any = 0;
+		for (int y = 0; y < chunkSize; y++)
+			any |= chunk.rows[y];
+		return any == 0;
+	}
+
+	static bool isFull(const Chunk& chunk)
+	{
+		uint64_t all = ~0ull;
+		for (int y = 0; y < chunkSize; y++)
+			all &= chunk.rows[y];
+		return all == ~0ull;
+	}
+
+	static uint64_t contentHash(const Chunk& chunk)
+	{
+		uint64_t hash = 0x9e3779b97f4a7c15ull;
+		for (int y = 0; y < chunkSize; y++)
+		{
+			hash ^= chunk.rows[y];
+			hash *= 0xff51afd7ed558ccdull;
+			hash ^= hash >> 32;
+		}
+		return hash;
+	}
+
+	Chunk* newChunk()
+	{
+		Chunk* chunk = new (pool.allocate(sizeof(Chunk))) Chunk;
+		chunk->refs = 1;
+		dedup.storedChunks++;
+		return chunk;
+	}
+
+	// drops one reference, the storage goes back to the pool with the last one
+	void release(Chunk* chunk)
+	{
+		if (chunk->flyweight) return;
+		if (--chunk->refs > 0) return;
+
+		if (chunk->interned)
+			interned.erase(chunk);
+		dedup.storedChunks--;
+		pool.deallocate(chunk, sizeof(Chunk));
+	}
+
+	// returns a referenced chunk with the given contents, shared with any identical chunk already stored
+	Chunk* intern(Chunk& contents)
+	{
+		if (isFull(contents))
+			return &fullChunk();
+
+		contents.hash = contentHash(contents);
+		auto it = interned.find(&contents);
+		if (it != interned.end())
+		{
+			(*it)->refs++;
+			dedup.dedupHits++;
+			return *it;
+		}
+
+		Chunk* chunk = newChunk();
+		std::memcpy(chunk->rows, contents.rows, sizeof(chunk->rows));
+		chunk->hash = contents.hash;
+		chunk->interned = true;
+		interned.insert(chunk);
+		return chunk;
+	}
+
+	// copy on write, makes the chunk at it private to this board position before it gets edited
+	Chunk* makeWritable(ChunkMap::iterator it)
+	{
+		Chunk* chunk = it->second;
+		if (chunk->flyweight || chunk->refs > 1)
+		{
+			Chunk* copy = newChunk();
+			std::memcpy(copy->rows, chunk->rows, sizeof(copy->rows));
+			release(chunk);
+			it->second = copy;
+			dedup.cowCopies++;
+			return copy;
+		}
+
+		// sole owner, just take it out of the intern table since its contents are about to change
+		if (chunk->interned)
+		{
+			interned.erase(chunk);
+			chunk->interned = false;
+		}
+		return chunk;
+	}
+
+	const Chunk* findChunk(int32_t cx, int32_t cy) const
+	{
+		auto it = chunks.find(chunkKey(cx, cy));
+		return it == chunks.end() ? nullptr : it->second;
+	}
+
+	bool isAlive(int64_t x, int64_t y) const
+	{
+		const Chunk* chunk = findChunk(chunkCoord(x), chunkCoord(y));
+		return chunk && BitKernel::getBit(&chunk->rows[localCoord(y)], localCoord(x));
+	}
+
+	void setState(int64_t x, int64_t y, bool alive)
+	{
+		uint64_t key = chunkKey(chunkCoord(x), chunkCoord(y));
+		auto it = chunks.find(key);
+		if (it == chunks.end())
+		{
+			if (!alive) return;
+			Chunk* chunk = newChunk();
+			std::memset(chunk->rows, 0, sizeof(chunk->rows));
+			it = chunks.emplace(key, chunk).first;
+		}
+		else if (BitKernel::getBit(&it->second->rows[localCoord(y)], localCoord(x)) == alive)
+		{
+			return; // no change, don't break sharing for nothing
+		}
+
+		Chunk* chunk = makeWritable(it);
+		BitKernel::setBit(&chunk->rows[localCoord(y)], localCoord(x), alive);
+
+		if (!alive && isEmpty(*chunk))
+		{
+			release(chunk);
+			chunks.erase(it);
+		}
+	}
+
+	void setAlive(int64_t x, int64_t y)
+	{
+		setState(x, y, true);
+	}
+
+	void setDead(int64_t x, int64_t y)
+	{
+		setState(x, y, false);
+	}
+
+	void toggleState(int64_t x, int64_t y)
+	{
+		setState(x, y, !isAlive(x, y));
+	}
+
+	void clear()
+	{
+		for (auto& entry : chunks)
+			release(entry.second);
+		chunks.clear();
+	}
+
+	size_t chunkCount() const
+	{
+		return chunks.size();
+	}
+
+	uint64_t population() const
+	{
+		uint64_t count = 0;
+		for (const auto& entry : chunks)
+			for (int y = 0; y < chunkSize; y++)
+				count += BitKernel::popcount(entry.second->rows[y]);
+		return count;
+	}
+
+	// smallest rectangle holding every live cell, inclusive, false if the universe is empty
+	bool boundingBox(int64_t& minX, int64_t& minY, int64_t& maxX, int64_t& maxY) const
+	{
+		bool found = false;
+		for (const auto& entry : chunks)
+		{
+			int64_t originX = static_cast<int64_t>(keyX(entry.first)) * chunkSize;
+			int64_t originY = static_cast<int64_t>(keyY(entry.first)) * chunkSize;
+			for (int y = 0; y < chunkSize; y++)
+			{
+				uint64_t row = entry.second->rows[y];
+				if (!row) continue;
+
+				int low = 0, high = chunkSize - 1;
+				while (!((row >> low) & 1)) low++;
+				while (!((row >> high) & 1)) high--;
+
+				if (!found)
+				{
+					minX = originX + low; maxX = originX + high;
+					minY = maxY = originY + y;
+					found = true;
+					continue;
+				}
+				if (originX + low < minX) minX = originX + low;
+				if (originX + high > maxX) maxX = originX + high;
+				if (originY + y < minY) minY = originY + y;
+				if (originY + y > maxY) maxY = originY + y;
+			}
+		}
+		return found;
+	}
+
+	const ArenaStats& arenaStats() const
+	{
+		return stats;
+	}
+
+	DedupStats dedupStats()
+	{
+		dedup.chunkRefs = chunks.size();
+		dedup.flyweightRefs = 0;
+		for (const auto& entry : chunks)
+			if (entry.second->flyweight)
+				dedup.flyweightRefs++;
+		dedup.residentBytes = dedup.storedChunks * sizeof(Chunk);
+		return dedup;
+	}
+
+	// steps one chunk given its 3x3 neighborhood, neighborhood[dy + 1][dx + 1]
+	static void stepChunk(const Chunk* neighborhood[3][3], Chunk& out, const Rule& rule)
+	{
+		for (int y = 0; y < chunkSize; y++)
+		{
+			uint64_t w[3], c[3], e[3]; // west, center and east words of the rows y - 1, y, y + 1
+
+			for (int r = 0; r < 3; r++)
+			{
+				int row = y + r - 1;
+				int band = 1;
+				if (row < 0) { row += chunkSize; band = 0; }
+				else if (row >= chunkSize) { row -= chunkSize; band = 2; }
+
+				w[r] = neighborhood[band][0]->rows[row];
+				c[r] = neighborhood[band][1]->rows[row];
+				e[r] = neighborhood[band][2]->rows[row];
+			}
+
+			out.rows[y] = BitKernel::nextWord(rule,
+				(c[0] << 1) | (w[0] >> 63), c[0], (c[0] >> 1) | (e[0] << 63),
+				(c[1] << 1) | (w[1] >> 63), c[1], (c[1] >> 1) | (e[1] << 63),
+				(c[2] << 1) | (w[2] >> 63), c[2], (c[2] >> 1) | (e[2] << 63));
+		}
+	}
+
+	void update()
+	{
+		if (gamePaused) return;
+		if (rule.births(0))
+			throw std::invalid_argument("ChunkedGrid: rules with b0 need a bounded board");
+
+		scratch.reset();
+		lastStep = BitKernel::StepCounts();
+
+		// every live chunk and its neighbors may hold live cells next generation
+		size_t candidateCount = 0;
+		uint64_t* candidates = scratch.allocateArray<uint64_t>(chunks.size() * 9);
+		for (const auto& entry : chunks)
+		{
+			int32_t cx = keyX(entry.first);
+			int32_t cy = keyY(entry.first);
+			for (int dy = -1; dy <= 1; dy++)
+				for (int dx = -1; dx <= 1; dx++)
+					candidates[candidateCount++] = chunkKey(cx + dx, cy + dy);
+		}
+		std::sort(candidates, candidates + candidateCount);
+		candidateCount = std::unique(candidates, candidates + candidateCount) - candidates;
+
+		size_t resultCount = 0;
+		uint64_t* resultKeys = scratch.allocateArray<uint64_t>(candidateCount);
+		Chunk** resultChunks = scratch.allocateArray<Chunk*>(candidateCount);
+
+		for (size_t i = 0; i < candidateCount; i++)
+		{
+			int32_t cx = keyX(candidates[i]);
+			int32_t cy = keyY(candidates[i]);
+
+			const Chunk* neighborhood[3][3];
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					const Chunk* chunk = findChunk(cx + dx, cy + dy);
+					neighborhood[dy + 1][dx + 1] = chunk ? chunk : &emptyChunk();
+				}
+			}
+
+			Chunk next;
+			stepChunk(neighborhood, next, rule);
+			if (countSteps)
+			{
+				for (int y = 0; y < chunkSize; y++)
+					lastStep.add(static_cast<int64_t>(cx) * chunkSize, static_cast<int64_t>(cy) * chunkSize + y, next.rows[y], neighborhood[1][1]->rows[y]);
+			}
+			if (isEmpty(next)) continue; // chunk died out, nothing to keep
+
+			// the old generation is still interned here, so still lifes and ash keep their storage
+			resultKeys[resultCount] = candidates[i];
+			resultChunks[resultCount] = intern(next);
+			resultCount++;
+		}
+
+		// swap generations, old references and map nodes go back to the pool for reuse
+		clear();
+		for (size_t i = 0; i < resultCount; i++)
+			chunks.emplace(resultKeys[i], resultChunks[i]);
+
+		generation++;
+	}
+};
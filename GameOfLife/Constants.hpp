@@ -1,4 +1,6 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 
 // note, before fixing the edge issue, save it in order to keep the tileSize 7, 1000x1000 fractal simulation
 
@@ -7,4 +9,20 @@ const int tileSize = 7;
 const int gameWidth = 1100;
 const int gameHeight = 1100;
 
-const int totalGridTiles = gameWidth / tileSize;
\ No newline at end of file
+const int totalGridTiles = gameWidth / tileSize;
+
+const unsigned int renderFrameRate = 60;
+const double simulationRate = 0; // generations per second on the simulation thread, 0 = as fast as possible
+
+// hyperspeed, several generations per drawn frame with only the last one published
+const int generationsPerFrame = 1; // 1 = publish every generation, N = N per frame, 0 = as many as fit the budget
+const double hyperspeedFrameBudget = 0.012; // seconds of stepping per frame when the count adapts
+const int maxGenerationsPerFrame = 1 << 16;
+// stepping backward in the window, see RewindBuffer
+const size_t rewindMemoryBudget = 64u << 20; // bytes of keyframes kept
+const double rewindReplayBudget = 0.05; // seconds of stepping between keyframes, the most a step back replays
+const uint64_t rewindKeyframeEvery = 256; // generations between keyframes when stepping is faster than that
+// undo / redo of edits in the window, see UndoHistory
+const size_t undoMemoryBudget = 16u << 20; // bytes of undo steps kept
+// headless --history, see History::Recorder
+const size_t historyQueueBudget = 64u << 20; // bytes of boards waiting to be coded before the run waits for the writer
@@ -0,0 +1,238 @@
+#pragma once
+#include "PngWriter.hpp"
+#include "SoftwareRenderer.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// records every Nth generation as a movie frame without slowing the simulation down
+// the simulation thread only copies the board into a free bit-packed frame (a memcpy per row for the bit
+// engines) and queues it, encoder threads draw it with the software renderer and write it out
+// there's a fixed number of frame buffers, if all of them are still waiting to be encoded the frame is
+// dropped (and counted) instead of making the simulation wait
+// output is a png sequence in a directory, or raw rgb frames on stdout for an external encoder, e.g.
+//   GameOfLife --headless --record - | ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH -i - out.mp4
+
+struct RecorderOptions
+{
+	std::string target; // directory for frame_000000.png ..., or "-" for raw rgb on stdout
+	uint64_t every = 1; // record generations that are a multiple of this
+	int encoders = 0; // 0 = one per hardware thread, leaving one for the simulation
+	size_t queueFrames = 8; // frame buffers, bounds the memory the recorder can use
+	RasterOptions raster;
+};
+
+struct FrameRecorder
+{
+	struct Job
+	{
+		BitFrame frame;
+		uint64_t index = 0; // position in the recording, dropped frames don't use one up
+	};
+
+	RecorderOptions options;
+	bool rawOutput;
+
+	std::vector<std::unique_ptr<Job>> jobs;
+	std::vector<Job*> freeJobs;
+	std::deque<Job*> queue;
+	std::mutex mutex;
+	std::condition_variable work;
+	std::condition_variable written; // raw frames have to reach stdout in order
+	std::vector<std::thread> encoders;
+	uint64_t nextIndex = 0;
+	uint64_t nextToWrite = 0;
+	bool finishing = false;
+	std::string error;
+
+	std::atomic<uint64_t> framesRecorded{ 0 };
+	std::atomic<uint64_t> framesDropped{ 0 };
+	std::atomic<uint64_t> bytesWritten{ 0 };
+
+	FrameRecorder(const RecorderOptions& opts) : options(opts), rawOutput(opts.target == "-")
+	{
+		if (options.every == 0) options.every = 1;
+		if (options.queueFrames == 0) options.queueFrames = 1;
+		options.raster.threads = 1; // frames are encoded side by side instead
+
+		if (rawOutput)
+		{
+#ifdef _WIN32
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		}
+		else
+		{
+			std::filesystem::create_directories(options.target);
+		}
+
+		for (size_t n = 0; n < options.queueFrames; n++)
+		{
+			jobs.push_back(std::make_unique<Job>());
+			freeJobs.push_back(jobs.back().get());
+		}
+
+		int count = options.encoders;
+		if (count <= 0)
+			count = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+		if (count < 1) count = 1;
+		for (int n = 0; n < count; n++)
+			encoders.emplace_back(&FrameRecorder::encoderLoop, this);
+	}
+
+	~FrameRecorder()
+	{
+		try
+		{
+			finish();
+		}
+		catch (const std::exception&)
+		{
+			// nowhere to report it from a destructor, call finish() first to find out
+		}
+	}
+
+	bool wants(uint64_t generation) const
+	{
+		return generation % options.every == 0;
+	}
+
+	// simulation thread, fill(frame) copies the board into the BitFrame it is handed
+	// returns false if the frame had to be dropped because the encoders are behind
+	template <typename Fill>
+	bool capture(uint64_t generation, Fill fill)
+	{
+		Job* job;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (freeJobs.empty() || finishing)
+			{
+				framesDropped++;
+				return false;
+			}
+			job = freeJobs.back();
+			freeJobs.pop_back();
+		}
+
+		// the buffer belongs to this thread until it is queued, copy without holding the lock
+		fill(job->frame);
+		job->frame.generation = generation;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job->index = nextIndex++;
+			queue.push_back(job);
+		}
+		work.notify_one();
+		return true;
+	}
+
+	// waits for every queued frame to be written and stops the encoders, throws if any frame failed
+	void finish()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (finishing && encoders.empty()) return;
+			finishing = true;
+		}
+		work.notify_all();
+		for (std::thread& encoder : encoders)
+			encoder.join();
+		encoders.clear();
+
+		if (rawOutput)
+			std::fflush(stdout);
+		if (!error.empty())
+			throw std::runtime_error("FrameRecorder: " + error);
+	}
+
+	std::string framePath(uint64_t index) const
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "frame_%06llu.png", static_cast<unsigned long long>(index));
+		return (std::filesystem::path(options.target) / name).string();
+	}
+
+	void encoderLoop()
+	{
+		SoftwareRenderer renderer(options.raster);
+		Image image;
+
+		while (true)
+		{
+			Job* job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				work.wait(lock, [&] { return finishing || !queue.empty(); });
+				if (queue.empty()) return; // finishing and nothing left
+				job = queue.front();
+				queue.pop_front();
+			}
+
+			renderer.render(job->frame, image);
+			uint64_t index = job->index;
+
+			// the bit frame isn't needed anymore, hand it back before the slow part
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				freeJobs.push_back(job);
+			}
+
+			std::string failure;
+			if (rawOutput)
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				written.wait(lock, [&] { return nextToWrite == index; });
+				lock.unlock();
+
+				// only the encoder holding the next index gets here, so writes never interleave
+				if (std::fwrite(image.pixels.data(), 1, image.pixels.size(), stdout) != image.pixels.size())
+					failure = "writing to stdout failed";
+				else
+					bytesWritten += image.pixels.size();
+
+				lock.lock();
+				nextToWrite++;
+				lock.unlock();
+				written.notify_all();
+			}
+			else
+			{
+				try
+				{
+					std::vector<uint8_t> png = Png::encode(image.width, image.height, image.pixels.data());
+					Png::save(framePath(index), png);
+					bytesWritten += png.size();
+				}
+				catch (const std::exception& e)
+				{
+					failure = e.what();
+				}
+			}
+
+			if (failure.empty())
+			{
+				framesRecorded++;
+			}
+			else
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (error.empty()) error = failure;
+			}
+		}
+	}
+};
@@ -5,43 +5,154 @@
 #include "Grid.hpp"
 #include "Constants.hpp"
 #include "InputManager.hpp"
+#include "BoardSetup.hpp"
+#include "PatternBrowser.hpp"
+#include "PatternLibrary.hpp"
+#include "RunOptions.hpp"
+#include <iostream>
+#include <memory>
 
 struct Game 
 {
     sf::RenderWindow& window;
+    std::unique_ptr<FrameRecorder> recorder; // outlives the simulation thread that feeds it
     Grid grid;
+    Simulation sim;
+    Renderer renderer;
     InputManager ip;
+    std::unique_ptr<PatternLibrary> library; // --library, browsed with L
+    std::unique_ptr<PatternBrowser> browser;
 
-    Game(sf::RenderWindow& win) : window(win), grid(), ip(grid)
+    Game(sf::RenderWindow& win, const RunOptions& options = RunOptions()) : window(win), grid(makeGrid(options)), sim(grid, simulationRate, options.rewindMemory, options.undoMemory),
+        renderer(win, grid.tiles.size() * grid.tiles[0].size()), ip(sim, renderer)
 	{
+        sim.stepsPerFrame = options.stepsPerFrame;
+        sim.frameBudget = options.frameBudget;
+        ip.stepsPerFrame = options.stepsPerFrame;
+        if (options.raster.colorMode == ColorMode::Age)
+        {
+            renderer.setColorMode(ColorMode::Age);
+            sim.publishAges = true; // the simulation thread isn't running yet
+            grid.dirtyAges = true;
+        }
+
+        if (!options.recordTarget.empty())
+        {
+            recorder = std::make_unique<FrameRecorder>(options.recorderOptions());
+            sim.recorder = recorder.get();
+        }
+
+        if (!options.libraryPath.empty())
+        {
+            library = std::make_unique<PatternLibrary>(options.libraryPath);
+            browser = std::make_unique<PatternBrowser>(*library, window);
+        }
         Run();
 	}
 
+    void handleEvent(const sf::Event& event)
+    {
+        if (event.type == sf::Event::Closed)
+            window.close();
+        else if (browser && browser->open)
+        {
+            size_t picked;
+            if (browser->handleEvent(event, picked))
+                pickPattern(picked);
+            if (!browser->open)
+                closeBrowser();
+        }
+        else if (browser && event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::L)
+            browser->toggle();
+        else
+            ip.handleEvent(event);
+    }
+
+    // the full pattern is only read now, clicks on the board place it until Escape
+    void pickPattern(size_t index)
+    {
+        try
+        {
+            ip.setStamp(std::make_shared<const PatternIO::Pattern>(library->load(index)));
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << '\n';
+        }
+    }
+
+    void closeBrowser()
+    {
+        renderer.invalidate();
+        if (!ip.stamp)
+            window.setTitle("GameOfLife");
+    }
+
+    // board from the command line, the usual random start if it didn't ask for anything
+    static Grid makeGrid(const RunOptions& options)
+    {
+        Grid grid(options.width, options.height);
+        if (!setUpBoard(grid, options))
+            grid.setRandomLiveTiles();
+        return grid;
+    }
+
     void Run()
     {
-        Renderer renderer(window, grid);
+        // the grid steps on the simulation thread from here on, this thread only draws snapshots
+        window.setFramerateLimit(renderFrameRate);
+        sim.start();
 
         // run the main loop
         while (window.isOpen())
         {
-            // handle events
+            // the pattern browser has the window to itself while it's open, it redraws as thumbnails come in
+            if (browser && browser->open)
+            {
+                sf::Event event;
+                while (window.pollEvent(event))
+                    handleEvent(event);
+                if (browser->open && browser->needsRedraw())
+                    browser->draw();
+                else
+                    sf::sleep(sf::seconds(1.f / renderFrameRate));
+                continue;
+            }
+
+            // paused with nothing new to show, sleep in the event queue until there's input instead of spinning
+            // (an edit in flight will publish a snapshot soon, so don't block then)
             sf::Event event;
+            const GridSnapshot* latest = &sim.latest();
+            if (latest->paused && !renderer.needsRedraw(*latest) && !sim.editsInFlight(*latest))
+            {
+                if (window.waitEvent(event))
+                    handleEvent(event);
+            }
+
+            // handle events
             while (window.pollEvent(event))
+                handleEvent(event);
+            if (!window.isOpen()) break;
+
+            // no new generation and no view change, wait for the simulation for up to a frame
+            latest = &sim.latest();
+            if (!renderer.needsRedraw(*latest))
             {
-                if (event.type == sf::Event::Closed)
-                    window.close();
-                else
-                    ip.handleEvent(event);
+                sim.waitForPublish(latest->sequence, 1.0 / renderFrameRate);
+                latest = &sim.latest();
             }
-            renderer.render(); // general render function which calls all render functions in renderer.hpp
-            grid.update(); // updates all tile states with logic applied
+
+            if (renderer.needsRedraw(*latest))
+                renderer.render(*latest); // general render function which calls all render functions in renderer.hpp
         }
+        sim.stop();
+        if (recorder)
+            recorder->finish(); // writes out whatever is still queued
+        if (library)
+            library->finish(); // keeps what got indexed for next time
     }
 };
 
-//todo: see if removing the grid-line renderer does anything for optimization
-//add option to clear board / reset board
+//todo: add option to clear board / reset board
 //add clicking and dragging 
-//look into threading for massive simulations
-//look into color gradients based on screen location
-//maybe add a menu / loading screen, and a selection for the buggy version i had without copying, could be cool larger scale
+//maybe add a selection for the buggy version i had without copying, could be cool larger scale
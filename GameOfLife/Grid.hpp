@@ -1,9 +1,24 @@
 #pragma once
 #include "Tile.hpp"
+#include "BitKernel.hpp"
 #include "Constants.hpp"
+#include "Rule.hpp"
+#include "CellAge.hpp"
+#include <algorithm>
 #include <vector>
 #include <iostream>
 #include <random>
+#include <cstdint>
+
+// population of each block x block square of tiles, one level of the density pyramid
+// used to draw the board zoomed out without touching every tile
+struct DensityLevel
+{
+	int block;
+	int columns;
+	int rows;
+	std::vector<uint16_t> counts; // index is (i / block) * rows + j / block
+};
 
 // TODO
 // should communicate with game and tile
@@ -16,15 +31,37 @@ struct Grid
 	int w;
 	int h;
 	bool gamePaused = true;
+	Rule rule;
 
 	std::vector<std::vector<Tile>> tiles; // 2d array of tiles, separate from rendered grid of lines
 
+	// tiles that changed state since the renderer last looked, index is i * rows + j
+	std::vector<size_t> dirtyTiles;
+	std::vector<char> dirtyMarks; // avoids listing a tile twice when several updates happen between frames
+
+	// generations since each tile last changed, see CellAge.hpp, same index as the dirty list
+	std::vector<uint8_t> ages;
+	bool dirtyAges = false; // while the ages are drawn, tiles that only got older go in the dirty list too
+
+	// population, births and bounding box of the last update, counted in its tile loop like the bit engines do
+	bool countSteps = false;
+	BitKernel::StepCounts lastStep;
+
+	// density pyramid (4x4 and 16x16 blocks), kept up to date as tiles change
+	std::vector<DensityLevel> densityLevels;
+
 	Grid() : w(gameWidth), h(gameHeight)
 	{
-		generateGridOfDeadTiles();
+		generateGridOfDeadTiles(totalGridTiles, totalGridTiles);
 		setRandomLiveTiles();
 	}
 
+	// dead board of columns x rows tiles, nothing here needs a window so batch runs can use it too
+	Grid(int columns, int rows) : w(gameWidth), h(gameHeight)
+	{
+		generateGridOfDeadTiles(columns, rows);
+	}
+
 	void update()
 	{
 		// iterate through all tiles
@@ -34,10 +71,13 @@ struct Grid
 			// copy grid to achieve simultaneous state changes 
 			std::vector<std::vector<Tile>> tilesCopy = tiles;
 
+			lastStep = BitKernel::StepCounts();
+
 			for (size_t i = 0; i < tiles.size() - 1; i++) {
-				for (size_t j = 0; j < tiles.size() - 1; j++) {
+				for (size_t j = 0; j < tiles[i].size() - 1; j++) {
 					Tile& tile = tiles[i][j]; // use & to ensure the tile is not a copy, since we edit the tiles directly
 					Tile& newTile = tilesCopy[i][j];
+					uint8_t& age = ages[i * tiles[i].size() + j];
 
 					std::vector<Tile> neighbors = getTileNeighbors(i, j); // get its neighbors
 					int numLivingNeighbors = 0;
@@ -52,29 +92,150 @@ struct Grid
 						}
 					}
 					// Apply the rules of the Game of Life
+					// (b3/s23 by default, see Rule.hpp)
 					if (tile.isAlive) 
 					{
-						if (numLivingNeighbors < 2 || numLivingNeighbors > 3) 
+						if (!rule.survives(numLivingNeighbors)) 
 						{
 							// Any live cell with fewer than two live neighbors dies (underpopulation)
 							// Any live cell with more than three live neighbors dies (overpopulation)
 							newTile.setDead();
+							tileChanged(i, j, false);
+							continue;
 						}
 					}
 					else
 					{
-						if (numLivingNeighbors == 3)
+						if (rule.births(numLivingNeighbors))
 						{
 							// Any dead cell with exactly three live neighbors becomes a live cell (reproduction)
 							newTile.setAlive();
+							tileChanged(i, j, true);
+							if (countSteps)
+							{
+								lastStep.births++;
+								countLive(i, j);
+							}
+							continue;
 						}
 					}
+
+					// kept its state, a generation older (tileChanged put the ones that flipped back to 0)
+					// a tile that has settled stays at maxAge, only the ones still counting up change color
+					if (dirtyAges && age != CellAge::maxAge)
+						markDirty(i, j);
+					age = CellAge::older(age);
+					if (countSteps && tile.isAlive)
+						countLive(i, j);
 				}
 			}
+
+			// the last column and row don't step, their live tiles still count
+			if (countSteps)
+			{
+				size_t lastI = tiles.size() - 1;
+				for (size_t j = 0; j < tiles[lastI].size(); j++)
+					if (tiles[lastI][j].isAlive)
+						countLive(lastI, j);
+				for (size_t i = 0; i < lastI; i++)
+					if (tiles[i].back().isAlive)
+						countLive(i, tiles[i].size() - 1);
+			}
 			tiles = tilesCopy; // set all state changes at the same time
 		}
 	}
 
+	void countLive(size_t i, size_t j)
+	{
+		lastStep.population++;
+		lastStep.addLive(static_cast<int64_t>(j), static_cast<int64_t>(i), static_cast<int64_t>(i));
+	}
+
+	bool isAlive(size_t i, size_t j) const
+	{
+		return tiles[i][j].isAlive;
+	}
+
+	void setTile(size_t i, size_t j, bool alive)
+	{
+		if (tiles[i][j].isAlive == alive) return;
+		tiles[i][j].isAlive = alive;
+		tileChanged(i, j, alive);
+	}
+
+	void setAlive(size_t i, size_t j)
+	{
+		setTile(i, j, true);
+	}
+
+	void setDead(size_t i, size_t j)
+	{
+		setTile(i, j, false);
+	}
+
+	uint8_t age(size_t i, size_t j) const
+	{
+		return ages[i * tiles[i].size() + j];
+	}
+
+	uint64_t population() const
+	{
+		uint64_t count = 0;
+		for (const std::vector<Tile>& column : tiles)
+			for (const Tile& tile : column)
+				count += tile.isAlive;
+		return count;
+	}
+
+	void toggleTile(size_t i, size_t j)
+	{
+		tiles[i][j].toggleState();
+		tileChanged(i, j, tiles[i][j].isAlive);
+	}
+
+	// every state change goes through here so the dirty list and density pyramid stay in sync
+	void tileChanged(size_t i, size_t j, bool nowAlive)
+	{
+		markDirty(i, j);
+		ages[i * tiles[i].size() + j] = 0;
+		for (DensityLevel& level : densityLevels)
+		{
+			uint16_t& count = level.counts[(i / level.block) * level.rows + j / level.block];
+			if (nowAlive)
+				count++;
+			else
+				count--;
+		}
+	}
+
+	// every tile as if it had always been in its state, the ones that weren't already change color
+	void resetAges()
+	{
+		if (dirtyAges)
+			for (size_t i = 0; i < tiles.size(); i++)
+				for (size_t j = 0; j < tiles[i].size(); j++)
+					if (age(i, j) != CellAge::maxAge)
+						markDirty(i, j);
+		std::fill(ages.begin(), ages.end(), CellAge::maxAge);
+	}
+
+	void markDirty(size_t i, size_t j)
+	{
+		size_t index = i * tiles[i].size() + j;
+		if (!dirtyMarks[index])
+		{
+			dirtyMarks[index] = 1;
+			dirtyTiles.push_back(index);
+		}
+	}
+
+	void clearDirty()
+	{
+		for (size_t index : dirtyTiles)
+			dirtyMarks[index] = 0;
+		dirtyTiles.clear();
+	}
+
 	std::vector<Tile> getTileNeighbors(size_t i, size_t j)
 	{
 		std::vector<Tile> neighbors;
@@ -88,8 +249,10 @@ struct Grid
 
 				// calculate neighbor indices with wrap-around
 				// remove the -1's and turn on random tiles for the edge glitch which produces interesting fractal designs
-				int neighborI = (static_cast<int>(i) + xOffset + totalGridTiles) % (totalGridTiles);
-				int neighborJ = (static_cast<int>(j) + yOffset + totalGridTiles) % (totalGridTiles);
+				int columns = static_cast<int>(tiles.size());
+				int rows = static_cast<int>(tiles[i].size());
+				int neighborI = (static_cast<int>(i) + xOffset + columns) % (columns);
+				int neighborJ = (static_cast<int>(j) + yOffset + rows) % (rows);
 
 				// add the wrapped-around neighbor to the list
 				neighbors.push_back(tiles[neighborI][neighborJ]);
@@ -98,16 +261,31 @@ struct Grid
 		return neighbors;
 	}
 
-	void generateGridOfDeadTiles()
+	void generateGridOfDeadTiles(int columns, int rows)
 	{
-		tiles.resize(totalGridTiles); // set number of rows 
+		tiles.clear();
+		tiles.resize(columns); // set number of rows 
 
-		for (size_t i = 0; i < totalGridTiles; i++) {
-			tiles[i].reserve(totalGridTiles); // reserve space for number of columns in each row
-			for (size_t j = 0; j < totalGridTiles; j++) {
+		for (size_t i = 0; i < static_cast<size_t>(columns); i++) {
+			tiles[i].reserve(rows); // reserve space for number of columns in each row
+			for (size_t j = 0; j < static_cast<size_t>(rows); j++) {
 				tiles[i].emplace_back(i, j); // only need Tile arguments because tiles is a vector of tile objects
 			}
 		}
+		dirtyTiles.clear();
+		dirtyMarks.assign(static_cast<size_t>(columns) * rows, 0);
+		ages.assign(static_cast<size_t>(columns) * rows, CellAge::maxAge);
+
+		densityLevels.clear();
+		for (int block : { 4, 16 })
+		{
+			DensityLevel level;
+			level.block = block;
+			level.columns = (columns + block - 1) / block;
+			level.rows = (rows + block - 1) / block;
+			level.counts.assign(static_cast<size_t>(level.columns) * level.rows, 0);
+			densityLevels.push_back(level);
+		}
 	}
 
 	void setRandomLiveTiles()
@@ -125,9 +303,10 @@ struct Grid
 				for (int j = 0; j < tiles[i].size(); j++)
 				{
 					int val = dis(gen);
-					if (val > threshold) 
+					if (val > threshold && !tiles[i][j].isAlive) 
 					{
 						tiles[i][j].setAlive();
+						tileChanged(i, j, true);
 					}
 				}
 			}
@@ -0,0 +1,455 @@
+#pragma once
+#include "BoardSetup.hpp"
+#include "Checkpoint.hpp"
+#include "CheckpointWriter.hpp"
+#include "ChunkedGrid.hpp"
+#include "FrameRecorder.hpp"
+#include "Grid.hpp"
+#include "History.hpp"
+#include "MappedGrid.hpp"
+#include "MortonGrid.hpp"
+#include "ParallelGrid.hpp"
+#include "PngWriter.hpp"
+#include "RunOptions.hpp"
+#include "SoftwareRenderer.hpp"
+#include "StatsSink.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+// batch runner for servers and scripts, steps one of the engines for a fixed number of generations
+// without ever opening a window, nothing in here (or in the engines) pulls in sfml graphics
+// progress goes to stdout (or --stats) one line at a time so it can be piped or tailed:
+//   generation 1000 population 51234 elapsed 1.234s rate 810.4 gen/s
+
+struct HeadlessRunner
+{
+	using clock = std::chrono::steady_clock;
+
+	RunOptions options;
+	std::ofstream statsFile;
+	std::ostream* stats = &std::cout;
+	uint64_t startGeneration = 0; // where a resumed run picks up
+	PatternIO::Pattern patternHeader; // name and comments of the starting pattern, written back by saveBoard
+
+	HeadlessRunner(const RunOptions& opts) : options(opts)
+	{
+		if (!options.statsPath.empty())
+		{
+			statsFile.open(options.statsPath);
+			if (!statsFile)
+				throw std::runtime_error("can't write " + options.statsPath);
+			stats = &statsFile;
+		}
+		else if (options.recordTarget == "-")
+		{
+			stats = &std::cerr; // stdout is carrying the video
+		}
+	}
+
+	int run()
+	{
+		// a checkpoint brings its own size and generation, and is resumed on the engine that wrote it unless told otherwise
+		if (!options.resumePath.empty())
+		{
+			Checkpoint::Header header = Checkpoint::readHeader(options.resumePath);
+			options.width = header.width;
+			options.height = header.height;
+			startGeneration = header.generation;
+			// a mapped board needs its file, without one the checkpoint goes on the default engine
+			std::string engine = Checkpoint::engineOf(header);
+			if (!options.engineGiven && isEngineName(engine) && (engine != "mapped" || !options.boardFile.empty()))
+				options.engine = engine;
+			*stats << "resuming " << options.resumePath << " at generation " << startGeneration << std::endl;
+		}
+
+		// so does a recorded history, the board itself is decoded by setUpBoard
+		if (!options.replayPath.empty())
+		{
+			History::Reader history(options.replayPath);
+			options.width = history.header.width;
+			options.height = history.header.height;
+			if (options.replayGeneration == UINT64_MAX)
+				options.replayGeneration = history.lastGeneration;
+			startGeneration = options.replayGeneration;
+			*stats << "replaying " << options.replayPath << " from generation " << startGeneration << " (recorded "
+				<< history.firstGeneration() << " to " << history.lastGeneration << ")" << std::endl;
+		}
+
+		// mapped boards keep their contents between runs, so only seed those when asked to
+		bool keepsBoard = options.engine == "mapped" || !options.resumePath.empty() || !options.replayPath.empty();
+		if (options.patternPath.empty() && !options.seeded && !keepsBoard)
+		{
+			std::random_device rd;
+			options.seed = (static_cast<uint64_t>(rd()) << 32) | rd();
+			options.seeded = true;
+		}
+
+		*stats << "engine " << options.engine << " size " << options.width << "x" << options.height
+			<< " rule " << options.rule.toString();
+		if (options.seeded && options.patternPath.empty())
+			*stats << " seed " << options.seed << " density " << options.density;
+		*stats << std::endl;
+
+		if (options.engine == "grid")
+		{
+			Grid grid(options.width, options.height);
+			return runEngine(grid);
+		}
+		if (options.engine == "morton")
+		{
+			MortonGrid grid(options.width, options.height);
+			return runEngine(grid);
+		}
+		if (options.engine == "chunked")
+		{
+			ChunkedGrid grid;
+			return runEngine(grid, false);
+		}
+		if (options.engine == "mapped")
+		{
+			MappedGrid grid(options.boardFile, options.width, options.height);
+			if (!options.patternPath.empty() || options.seeded || !options.resumePath.empty() || !options.replayPath.empty())
+				grid.clear();
+			return runEngine(grid);
+		}
+
+		ParallelGridOptions parallelOptions;
+		parallelOptions.threads = options.threads;
+		parallelOptions.pinThreads = options.pinThreads;
+		parallelOptions.hugePages = options.hugePages;
+		parallelOptions.trackAges = options.raster.colorMode == ColorMode::Age;
+		parallelOptions.countSteps = !options.generationStatsPath.empty();
+		ParallelGrid grid(options.width, options.height, parallelOptions);
+		return runEngine(grid);
+	}
+
+	template <typename Engine>
+	int runEngine(Engine& engine, bool bounded = true)
+	{
+		setUpBoard(engine, options, bounded, &patternHeader);
+		engine.gamePaused = false;
+		if (engine.rule != options.rule)
+			*stats << "rule " << engine.rule.toString() << " from " << startingFile() << std::endl;
+
+		// frames are only copied here, drawing and encoding happens on the recorder's threads
+		std::unique_ptr<FrameRecorder> recorder;
+		if (!options.recordTarget.empty())
+			recorder = std::make_unique<FrameRecorder>(options.recorderOptions());
+		auto recordFrame = [&](uint64_t generation)
+		{
+			if (recorder && recorder->wants(generation))
+				recorder->capture(generation, [&](BitFrame& frame) { captureFrame(engine, frame); });
+		};
+
+		// checkpoints are only snapshotted here, the writer thread puts them on disk while we carry on
+		// (it lives in here, so it is gone before the engine whose rows it may still be reading)
+		std::unique_ptr<CheckpointWriter> checkpoints;
+		if (!options.checkpointPath.empty())
+			checkpoints = std::make_unique<CheckpointWriter>(options.checkpointOptions(), startGeneration);
+		uint64_t checkpointed = UINT64_MAX; // generation of the last checkpoint started
+		auto checkpoint = [&](uint64_t generation)
+		{
+			if (checkpoints->start([&](CheckpointWriter::Job& job) { return snapshot(engine, generation, job); }))
+				checkpointed = generation;
+			reportCheckpoints(*checkpoints);
+		};
+
+		// every generation goes in, copied here and coded on the history's own thread
+		std::unique_ptr<History::Recorder> history;
+		if (!options.historyPath.empty())
+			history = std::make_unique<History::Recorder>(std::make_unique<History::Writer>(options.historyPath, engine.rule, startGeneration,
+				static_cast<uint32_t>(options.keyframeEvery)));
+		auto record = [&](uint64_t generation)
+		{
+			recordFrame(generation);
+			if (history)
+				history->capture(generation, [&](BitFrame& frame) { captureFrame(engine, frame); });
+		};
+
+		// counted by the engine while it steps, only queued here and written on the sink's thread
+		std::unique_ptr<StatsSink> generationStats;
+		if (!options.generationStatsPath.empty())
+		{
+			generationStats = std::make_unique<StatsSink>(options.generationStatsPath);
+			countSteps(engine);
+		}
+
+		uint64_t previousPopulation = generationStats ? engine.population() : 0;
+		auto start = clock::now();
+		uint64_t lastGeneration = startGeneration + options.generations;
+		record(startGeneration);
+		for (uint64_t step = 1; step <= options.generations; step++)
+		{
+			if (generationStats)
+			{
+				auto stepBegin = clock::now();
+				engine.update();
+				double seconds = std::chrono::duration<double>(clock::now() - stepBegin).count();
+				GenerationStats generation = stepStats(engine, startGeneration + step, seconds);
+				// every cell that was alive is still alive, died, and every live cell was alive or was born
+				generation.deaths = previousPopulation + generation.births - generation.population;
+				previousPopulation = generation.population;
+				generationStats->push(generation);
+			}
+			else
+			{
+				engine.update();
+			}
+			record(startGeneration + step);
+			if (checkpoints && checkpoints->due(startGeneration + step))
+				checkpoint(startGeneration + step);
+			if (options.reportEvery > 0 && step % options.reportEvery == 0 && step != options.generations)
+				report(startGeneration + step, step, engine.population(), start);
+		}
+		report(lastGeneration, options.generations, engine.population(), start);
+		reportEngine(engine);
+
+		if (recorder)
+		{
+			recorder->finish();
+			*stats << "recorded " << recorder->framesRecorded << " frames, dropped " << recorder->framesDropped
+				<< ", " << recorder->bytesWritten << " bytes" << std::endl;
+		}
+
+		if (generationStats)
+		{
+			generationStats->finish();
+			*stats << "generation stats " << options.generationStatsPath << " " << generationStats->recordsWritten << " records, "
+				<< generationStats->bytesWritten << " bytes, the writer fell behind " << generationStats->stalls << " times" << std::endl;
+		}
+
+		if (history)
+		{
+			history->finish();
+			const History::Writer& written = *history->writer;
+			*stats << "history " << options.historyPath << " " << written.generations << " generations, " << written.keyframes.size()
+				<< " keyframes, " << written.bytes << " bytes (" << (written.rawBytes > 0 ? 100.0 * written.bytes / written.rawBytes : 0.0)
+				<< "% of the full boards), waited for the writer " << history->waits << " times" << std::endl;
+		}
+
+		if (checkpoints)
+		{
+			checkpoints->wait();
+			if (checkpointed != lastGeneration)
+				checkpoint(lastGeneration);
+			checkpoints->finish();
+			reportCheckpoints(*checkpoints);
+			if (checkpoints->checkpointsWritten > 1)
+				*stats << "checkpoints " << checkpoints->checkpointsWritten << ", " << checkpoints->bytesWritten << " bytes in "
+					<< checkpoints->writeSeconds << "s (" << megabytesPerSecond(checkpoints->bytesWritten, checkpoints->writeSeconds)
+					<< " MB/s)" << std::endl;
+		}
+		if (!options.outputPath.empty())
+			saveBoard(engine);
+		if (!options.imagePath.empty())
+		{
+			BitFrame frame;
+			captureFrame(engine, frame);
+			saveImage(frame);
+		}
+		return 0;
+	}
+
+	// the engines count population, births and the bounding box as they step
+	template <typename Engine>
+	static void countSteps(Engine& engine)
+	{
+		engine.countSteps = true;
+	}
+
+	static void countSteps(ParallelGrid&)
+	{
+		// already asked for through ParallelGridOptions
+	}
+
+	template <typename Engine>
+	static GenerationStats stepStats(Engine& engine, uint64_t generation, double seconds)
+	{
+		const BitKernel::StepCounts& counts = engine.lastStep;
+		return { generation, counts.population, counts.births, 0, counts.minX, counts.minY, counts.maxX, counts.maxY, seconds };
+	}
+
+	const std::string& startingFile() const
+	{
+		return !options.resumePath.empty() ? options.resumePath : !options.replayPath.empty() ? options.replayPath : options.patternPath;
+	}
+
+	// what an engine keeps about its own memory, only the chunked universe has anything to say
+	template <typename Engine>
+	void reportEngine(Engine&)
+	{
+	}
+
+	void reportEngine(ChunkedGrid& engine)
+	{
+		const ArenaStats& arena = engine.arenaStats();
+		*stats << "chunk pool " << arena.liveBlocks << " live blocks in " << arena.slabs << " slabs, " << arena.poolBytesReserved
+			<< " bytes reserved, " << arena.blockAllocs << " allocs " << arena.blockFrees << " frees " << arena.oversizeAllocs << " oversize" << std::endl;
+		*stats << "scratch arena " << arena.scratchAllocs << " allocs over " << arena.scratchResets << " resets, peak "
+			<< arena.scratchBytesPeak << " of " << arena.scratchBytesReserved << " bytes reserved" << std::endl;
+
+		DedupStats dedup = engine.dedupStats();
+		*stats << "chunk sharing " << dedup.chunkRefs << " chunks on the board in " << dedup.storedChunks << " distinct ("
+			<< dedup.flyweightRefs << " all alive), " << dedup.dedupHits << " found already interned, " << dedup.cowCopies
+			<< " copied on write, " << dedup.residentBytes << " bytes" << std::endl;
+	}
+
+	// steps is how many generations this run has stepped, for the rate
+	void report(uint64_t generation, uint64_t steps, uint64_t population, clock::time_point start)
+	{
+		double seconds = std::chrono::duration<double>(clock::now() - start).count();
+		*stats << "generation " << generation << " population " << population
+			<< " elapsed " << seconds << "s rate " << (seconds > 0 ? steps / seconds : 0.0) << " gen/s" << std::endl;
+	}
+
+	// checkpoint snapshots, the parallel and mapped engines freeze their rows and the writer reads them in place,
+	// the rest are copied into the job's frame (a memcpy per row for the bit engines)
+	template <typename Engine>
+	bool snapshot(Engine& engine, uint64_t generation, CheckpointWriter::Job& job)
+	{
+		captureFrame(engine, job.frame);
+		job.header = Checkpoint::makeHeader(job.frame.width, job.frame.height, engine.rule, generation, options.engine);
+		return true;
+	}
+
+	bool snapshot(ParallelGrid& engine, uint64_t generation, CheckpointWriter::Job& job)
+	{
+		if (!engine.freeze(job.rows))
+			return false;
+		job.header = Checkpoint::makeHeader(engine.w, engine.h, engine.rule, generation, options.engine);
+		job.rowWords = engine.stride;
+		job.done = [&engine] { engine.thaw(); };
+		return true;
+	}
+
+	// an out-of-core board is never copied to the heap, the writer reads it from the mapping
+	bool snapshot(MappedGrid& engine, uint64_t generation, CheckpointWriter::Job& job)
+	{
+		if (!engine.freeze(job.rows))
+			return false;
+		job.header = Checkpoint::makeHeader(engine.w, engine.h, engine.rule, generation, options.engine);
+		job.rowWords = engine.wordsPerRow;
+		job.done = [&engine] { engine.thaw(); };
+		return true;
+	}
+
+	// the chunked universe saves what its live cells cover, the header keeps where that was
+	bool snapshot(ChunkedGrid& engine, uint64_t generation, CheckpointWriter::Job& job)
+	{
+		int64_t minX = 0, minY = 0, maxX = 0, maxY = 0;
+		if (!engine.boundingBox(minX, minY, maxX, maxY))
+			maxX = maxY = 0;
+		if (maxX - minX + 1 > INT32_MAX || maxY - minY + 1 > INT32_MAX)
+			throw std::runtime_error("the live cells cover too much of the universe for a checkpoint");
+
+		job.frame.captureCells(static_cast<int>(maxX - minX + 1), static_cast<int>(maxY - minY + 1),
+			[&](int x, int y) { return engine.isAlive(minX + x, minY + y); });
+		job.header = Checkpoint::makeHeader(job.frame.width, job.frame.height, engine.rule, generation, options.engine);
+		job.header.originX = minX;
+		job.header.originY = minY;
+		return true;
+	}
+
+	void reportCheckpoints(CheckpointWriter& checkpoints)
+	{
+		CheckpointWriter::Completed done;
+		while (checkpoints.takeCompleted(done))
+			*stats << "checkpoint " << options.checkpointPath << " generation " << done.generation << " " << done.bytes
+				<< " bytes, snapshot " << done.snapshotSeconds * 1000 << "ms, written in " << done.writeSeconds << "s ("
+				<< megabytesPerSecond(done.bytes, done.writeSeconds) << " MB/s)" << std::endl;
+	}
+
+	static double megabytesPerSecond(uint64_t bytes, double seconds)
+	{
+		return seconds > 0 ? bytes / seconds / (1 << 20) : 0.0;
+	}
+
+	template <typename Engine>
+	void saveBoard(Engine& engine)
+	{
+		PatternIO::save(options.outputPath, 0, 0, options.width, options.height,
+			[&](int64_t x, int64_t y) { return engine.isAlive(static_cast<int>(x), static_cast<int>(y)); }, patternHeader.name, engine.rule, savedComments());
+	}
+
+	// the chunked universe has no edges, save whatever the live cells cover
+	void saveBoard(ChunkedGrid& engine)
+	{
+		int64_t minX = 0, minY = 0, maxX = -1, maxY = -1;
+		engine.boundingBox(minX, minY, maxX, maxY);
+		PatternIO::save(options.outputPath, minX, minY, maxX - minX + 1, maxY - minY + 1,
+			[&](int64_t x, int64_t y) { return engine.isAlive(x, y); }, patternHeader.name, engine.rule, savedComments());
+	}
+
+	// the pattern's comments minus the ones about where it sat (#P / #R offsets in .rle, #R rule and #G generation
+	// in .mc), those don't describe the saved board and would be misread in the other format
+	std::vector<std::string> savedComments() const
+	{
+		std::vector<std::string> comments;
+		for (const std::string& comment : patternHeader.comments)
+			if (comment.compare(0, 2, "#P") != 0 && comment.compare(0, 2, "#R") != 0 && comment.compare(0, 2, "#G") != 0)
+				comments.push_back(comment);
+		return comments;
+	}
+
+	// bit-packed copy of the board for the software renderer, engines with bit rows are copied a row at a time
+	template <typename Engine>
+	void captureFrame(Engine& engine, BitFrame& frame)
+	{
+		frame.captureCells(options.width, options.height, [&](int x, int y) { return engine.isAlive(x, y); });
+	}
+
+	void captureFrame(Grid& engine, BitFrame& frame)
+	{
+		frame.captureCells(options.width, options.height, [&](int x, int y) { return engine.isAlive(x, y); });
+		if (options.raster.colorMode == ColorMode::Age)
+			frame.captureAges(options.width, options.height, [&](int x, int y) { return engine.age(x, y); });
+	}
+
+	void captureFrame(ParallelGrid& engine, BitFrame& frame)
+	{
+		frame.captureRows(engine.w, engine.h, [&](int y) { return engine.row(y); });
+		if (options.raster.colorMode == ColorMode::Age)
+			frame.captureAgeRows(engine.w, engine.h, [&](int y) { return engine.ageRow(y); });
+	}
+
+	void captureFrame(MappedGrid& engine, BitFrame& frame)
+	{
+		frame.captureRows(engine.w, engine.h, [&](int y) { return engine.row(y); });
+	}
+
+	// only the board area is drawn for the chunked universe, so every frame of a recording has the same size
+	void captureFrame(ChunkedGrid& engine, BitFrame& frame)
+	{
+		frame.captureCells(options.width, options.height, [&](int x, int y) { return engine.isAlive(x, y); });
+	}
+
+	void saveImage(const BitFrame& frame)
+	{
+		Image image;
+		SoftwareRenderer(options.raster).render(frame, image);
+
+		if (PatternIO::hasExtension(options.imagePath, ".png"))
+		{
+			Png::save(options.imagePath, image.width, image.height, image.pixels.data());
+		}
+		else
+		{
+			std::ofstream out(options.imagePath, std::ios::binary);
+			if (!out || !out.write(reinterpret_cast<const char*>(image.pixels.data()), image.pixels.size()))
+				throw std::runtime_error("can't write " + options.imagePath);
+		}
+		*stats << "image " << options.imagePath << " " << image.width << "x" << image.height << std::endl;
+	}
+};
+
+inline int runHeadless(const RunOptions& options)
+{
+	HeadlessRunner runner(options);
+	return runner.run();
+}
@@ -0,0 +1,545 @@
+#pragma once
+#include "BitKernel.hpp"
+#include "Constants.hpp"
+#include "Rule.hpp"
+#include "SoftwareRenderer.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// every generation of a run in one append-only file, for going back over a run afterwards
+// a full keyframe every K generations and the XOR against the previous generation in between, both coded
+// as runs over the bit-packed board (BitFrame rows, stride words each): varint count of zero words, varint
+// count of literal words, the literal words, repeated until the board is covered
+// a literal word is a byte with a bit for each of its nonzero bytes followed by just those bytes, the edge
+// of a moving object usually only touches one or two bytes of a word
+// so a quiet board costs a few bytes a generation, and any generation is one keyframe plus fewer than K
+// deltas away
+// file layout: FileHeader, records (RecordHeader then its payload) in generation order, and once the
+// recording finished an index of the keyframes and a Trailer pointing at it
+// a file cut short (the run was killed) has no trailer, the reader then finds the keyframes by walking the
+// records and ignores a half written last one
+// integers are stored little endian, which is what every machine we build for is
+
+namespace History
+{
+	const uint32_t fileVersion = 1;
+
+	struct FileHeader
+	{
+		char magic[4]; // "GOLH"
+		uint32_t version;
+		int32_t width;
+		int32_t height;
+		uint64_t firstGeneration;
+		uint32_t keyframeEvery;
+		uint16_t birth; // Rule masks
+		uint16_t survival;
+	};
+
+	enum RecordKind : uint32_t
+	{
+		Keyframe = 1,
+		Delta = 2
+	};
+
+	struct RecordHeader
+	{
+		uint64_t generation;
+		uint64_t payloadBytes;
+		uint32_t kind;
+		uint32_t reserved;
+	};
+
+	struct IndexEntry
+	{
+		uint64_t generation;
+		uint64_t offset; // of the keyframe's RecordHeader
+	};
+
+	struct Trailer
+	{
+		uint64_t indexOffset;
+		uint64_t entries;
+		char magic[8]; // "GOLHIDX"
+	};
+
+	inline void putVarint(std::vector<uint8_t>& out, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	inline uint64_t getVarint(const uint8_t*& data, const uint8_t* end)
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			if (data == end)
+				throw std::runtime_error("History: record ends in the middle of a number");
+			uint8_t byte = *data++;
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+				return value;
+		}
+		throw std::runtime_error("History: number too long");
+	}
+
+	// codes words ^ previous (just words for a keyframe, previous = nullptr), appending to out
+	inline void encode(const uint64_t* words, const uint64_t* previous, size_t count, std::vector<uint8_t>& out)
+	{
+		size_t i = 0;
+		while (i < count)
+		{
+			size_t zeros = 0;
+			while (i + zeros < count && (words[i + zeros] ^ (previous ? previous[i + zeros] : 0)) == 0)
+				zeros++;
+			size_t first = i + zeros;
+			size_t literals = 0;
+			while (first + literals < count && (words[first + literals] ^ (previous ? previous[first + literals] : 0)) != 0)
+				literals++;
+
+			putVarint(out, zeros);
+			putVarint(out, literals);
+			for (size_t n = 0; n < literals; n++)
+			{
+				uint64_t word = words[first + n] ^ (previous ? previous[first + n] : 0);
+				size_t maskAt = out.size();
+				out.push_back(0);
+				for (int b = 0; b < 8; b++)
+				{
+					uint8_t byte = static_cast<uint8_t>(word >> (b * 8));
+					if (byte)
+					{
+						out[maskAt] |= static_cast<uint8_t>(1 << b);
+						out.push_back(byte);
+					}
+				}
+			}
+			i = first + literals;
+		}
+	}
+
+	// xors a coded payload into words, on a cleared board that decodes a keyframe
+	inline void apply(const uint8_t* data, size_t bytes, uint64_t* words, size_t count)
+	{
+		const uint8_t* end = data + bytes;
+		size_t i = 0;
+		while (data < end)
+		{
+			uint64_t zeros = getVarint(data, end);
+			uint64_t literals = getVarint(data, end);
+			if (zeros > count - i || literals > count - i - zeros)
+				throw std::runtime_error("History: record doesn't fit the board");
+			i += zeros;
+			for (uint64_t n = 0; n < literals; n++, i++)
+			{
+				if (data == end)
+					throw std::runtime_error("History: record cut short");
+				uint8_t mask = *data++;
+				uint64_t word = 0;
+				for (int b = 0; b < 8; b++)
+				{
+					if (!((mask >> b) & 1)) continue;
+					if (data == end)
+						throw std::runtime_error("History: record cut short");
+					word |= static_cast<uint64_t>(*data++) << (b * 8);
+				}
+				words[i] ^= word;
+			}
+		}
+	}
+
+	// appends generations to a new history file, not thread safe, see Recorder for the background version
+	// the board size comes from the first frame
+	struct Writer
+	{
+		std::string path;
+		std::ofstream out;
+		FileHeader header;
+		std::vector<IndexEntry> keyframes;
+		BitFrame previous;
+		bool havePrevious = false;
+		uint64_t lastGeneration = 0;
+		uint64_t generations = 0;
+		uint64_t bytes = 0;
+		uint64_t rawBytes = 0; // what the same generations would take stored whole
+		std::vector<uint8_t> payload;
+
+		Writer(const std::string& filePath, const Rule& rule, uint64_t firstGeneration, uint32_t keyframeEvery)
+			: path(filePath), out(filePath, std::ios::binary | std::ios::trunc)
+		{
+			if (!out)
+				throw std::runtime_error("History: can't write " + path);
+			std::memset(&header, 0, sizeof(header));
+			std::memcpy(header.magic, "GOLH", 4);
+			header.version = fileVersion;
+			header.firstGeneration = firstGeneration;
+			header.keyframeEvery = keyframeEvery > 0 ? keyframeEvery : 1;
+			header.birth = rule.birth;
+			header.survival = rule.survival;
+		}
+
+		void write(const void* data, size_t count)
+		{
+			out.write(static_cast<const char*>(data), static_cast<std::streamsize>(count));
+			if (!out)
+				throw std::runtime_error("History: writing " + path + " failed");
+			bytes += count;
+		}
+
+		// generations have to come one after the other, starting at the header's first generation
+		void append(const BitFrame& frame)
+		{
+			if (generations == 0)
+			{
+				header.width = frame.width;
+				header.height = frame.height;
+				write(&header, sizeof(header));
+			}
+			if (frame.width != header.width || frame.height != header.height)
+				throw std::invalid_argument("History: frame size changed during the recording");
+			uint64_t expected = havePrevious ? lastGeneration + 1 : header.firstGeneration;
+			if (frame.generation != expected)
+				throw std::invalid_argument("History: generation " + std::to_string(frame.generation) + " recorded out of order");
+
+			bool keyframe = (frame.generation - header.firstGeneration) % header.keyframeEvery == 0;
+			payload.clear();
+			encode(frame.words.data(), keyframe ? nullptr : previous.words.data(), frame.words.size(), payload);
+
+			RecordHeader record = { frame.generation, payload.size(), keyframe ? Keyframe : Delta, 0 };
+			if (keyframe)
+				keyframes.push_back({ frame.generation, bytes });
+			write(&record, sizeof(record));
+			write(payload.data(), payload.size());
+
+			previous.width = frame.width;
+			previous.height = frame.height;
+			previous.stride = frame.stride;
+			previous.words = frame.words;
+			havePrevious = true;
+			lastGeneration = frame.generation;
+			generations++;
+			rawBytes += frame.words.size() * sizeof(uint64_t);
+		}
+
+		// writes the index, a file that never gets here is still readable, just slower to open
+		void close()
+		{
+			if (!out.is_open()) return;
+			if (generations == 0)
+				write(&header, sizeof(header)); // nothing recorded, still a valid (empty) file
+			Trailer trailer = { bytes, keyframes.size(), "GOLHIDX" };
+			write(keyframes.data(), keyframes.size() * sizeof(IndexEntry));
+			write(&trailer, sizeof(trailer));
+			out.close();
+		}
+	};
+
+	// records from the simulation thread, the board is copied into a free frame and coded and written on a
+	// background thread
+	// frames are only allocated when none is free, as many as fit the memory budget (at least two), so a small
+	// board can get far ahead of the writer and a huge one doesn't take gigabytes
+	// unlike FrameRecorder nothing can be dropped (every delta builds on the one before), so capture waits for
+	// a free frame once the budget is used up
+	struct Recorder
+	{
+		std::unique_ptr<Writer> writer;
+		std::vector<std::unique_ptr<BitFrame>> frames;
+		std::vector<BitFrame*> freeFrames;
+		std::deque<BitFrame*> queue;
+		std::mutex mutex;
+		std::condition_variable work;
+		std::condition_variable frameFree;
+		std::thread thread;
+		bool finishing = false;
+		std::string error;
+		size_t memoryBudget;
+		uint64_t waits = 0; // captures that had to wait for the writer
+
+		Recorder(std::unique_ptr<Writer> historyWriter, size_t budget = historyQueueBudget) : writer(std::move(historyWriter)), memoryBudget(budget)
+		{
+			thread = std::thread(&Recorder::writerLoop, this);
+		}
+
+		~Recorder()
+		{
+			try
+			{
+				finish();
+			}
+			catch (const std::exception&)
+			{
+				// nowhere to report it from a destructor, call finish() first to find out
+			}
+		}
+
+		Recorder(const Recorder&) = delete;
+		Recorder& operator=(const Recorder&) = delete;
+
+		// fill(frame) copies the board into the BitFrame it is handed
+		template <typename Fill>
+		void capture(uint64_t generation, Fill fill)
+		{
+			BitFrame* frame;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				if (freeFrames.empty() && canAllocate())
+				{
+					frames.push_back(std::make_unique<BitFrame>());
+					freeFrames.push_back(frames.back().get());
+				}
+				if (freeFrames.empty())
+					waits++;
+				frameFree.wait(lock, [&] { return !freeFrames.empty() || !error.empty(); });
+				if (!error.empty())
+					throw std::runtime_error("History: " + error);
+				frame = freeFrames.back();
+				freeFrames.pop_back();
+			}
+
+			fill(*frame);
+			frame->generation = generation;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				queue.push_back(frame);
+			}
+			work.notify_one();
+		}
+
+		// the first frame tells how big a board is, every frame is the same size
+		bool canAllocate() const
+		{
+			if (frames.size() < 2) return true;
+			size_t frameBytes = frames[0]->words.capacity() * sizeof(uint64_t) + sizeof(BitFrame);
+			return (frames.size() + 1) * frameBytes <= memoryBudget;
+		}
+
+		// writes whatever is queued and the index, throws if anything failed
+		void finish()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				finishing = true;
+			}
+			work.notify_all();
+			if (thread.joinable())
+				thread.join();
+
+			if (!error.empty())
+				throw std::runtime_error("History: " + error);
+			writer->close();
+		}
+
+		void writerLoop()
+		{
+			while (true)
+			{
+				BitFrame* frame;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					work.wait(lock, [&] { return finishing || !queue.empty(); });
+					if (queue.empty()) return; // finishing and nothing left
+					frame = queue.front();
+					queue.pop_front();
+				}
+
+				std::string failure;
+				try
+				{
+					writer->append(*frame);
+				}
+				catch (const std::exception& e)
+				{
+					failure = e.what();
+				}
+
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					freeFrames.push_back(frame);
+					if (!failure.empty() && error.empty())
+						error = failure;
+				}
+				frameFree.notify_one();
+				if (!failure.empty())
+					return;
+			}
+		}
+	};
+
+	// any recorded generation of a history file, seeking forward from the generation last returned only
+	// decodes the deltas in between, anything else starts over from the nearest keyframe before it
+	struct Reader
+	{
+		std::string path;
+		std::ifstream in;
+		FileHeader header;
+		uint64_t fileBytes = 0;
+		uint64_t recordsEnd = 0; // where the index starts, or the end of the last whole record
+		std::vector<IndexEntry> keyframes;
+		uint64_t lastGeneration = 0;
+
+		BitFrame board;
+		bool haveBoard = false;
+		uint64_t nextOffset = 0; // record after the board's generation
+		std::vector<uint8_t> payload;
+
+		Reader(const std::string& filePath) : path(filePath), in(filePath, std::ios::binary)
+		{
+			if (!in)
+				throw std::runtime_error("History: can't open " + path);
+			in.seekg(0, std::ios::end);
+			fileBytes = static_cast<uint64_t>(in.tellg());
+			in.seekg(0);
+			if (fileBytes < sizeof(FileHeader) || !in.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, "GOLH", 4) != 0)
+				throw std::runtime_error("History: " + path + " is not a history file");
+			if (header.version != fileVersion)
+				throw std::runtime_error("History: " + path + " is version " + std::to_string(header.version) + ", this build reads version " + std::to_string(fileVersion));
+			if (header.width <= 0 || header.height <= 0 || header.keyframeEvery == 0)
+				throw std::runtime_error("History: " + path + " is damaged");
+
+			if (!readIndex())
+				scanRecords();
+			if (keyframes.empty())
+				throw std::runtime_error("History: " + path + " has no generations in it");
+			board.resize(header.width, header.height);
+		}
+
+		Rule rule() const
+		{
+			Rule fileRule;
+			fileRule.birth = header.birth;
+			fileRule.survival = header.survival;
+			return fileRule;
+		}
+
+		uint64_t firstGeneration() const
+		{
+			return header.firstGeneration;
+		}
+
+		bool readIndex()
+		{
+			Trailer trailer;
+			if (fileBytes < sizeof(FileHeader) + sizeof(Trailer)) return false;
+			in.seekg(static_cast<std::streamoff>(fileBytes - sizeof(Trailer)));
+			if (!in.read(reinterpret_cast<char*>(&trailer), sizeof(trailer)) || std::memcmp(trailer.magic, "GOLHIDX", 8) != 0)
+				return false;
+			if (trailer.indexOffset < sizeof(FileHeader) || trailer.indexOffset > fileBytes - sizeof(Trailer)
+				|| trailer.entries != (fileBytes - sizeof(Trailer) - trailer.indexOffset) / sizeof(IndexEntry))
+				return false;
+
+			keyframes.resize(trailer.entries);
+			in.seekg(static_cast<std::streamoff>(trailer.indexOffset));
+			if (!in.read(reinterpret_cast<char*>(keyframes.data()), static_cast<std::streamsize>(keyframes.size() * sizeof(IndexEntry))))
+				return false;
+			recordsEnd = trailer.indexOffset;
+
+			// the index only has keyframes, the last generation is in the last keyframe's run of deltas
+			lastGeneration = 0;
+			if (!keyframes.empty())
+			{
+				uint64_t offset = keyframes.back().offset;
+				RecordHeader record;
+				while (readRecordHeader(offset, record))
+				{
+					lastGeneration = record.generation;
+					offset += sizeof(RecordHeader) + record.payloadBytes;
+				}
+			}
+			return true;
+		}
+
+		// no index, walks the records instead, a half written last record ends the file
+		void scanRecords()
+		{
+			keyframes.clear();
+			recordsEnd = fileBytes;
+			uint64_t offset = sizeof(FileHeader);
+			RecordHeader record;
+			while (readRecordHeader(offset, record))
+			{
+				if (record.kind == Keyframe)
+					keyframes.push_back({ record.generation, offset });
+				lastGeneration = record.generation;
+				offset += sizeof(RecordHeader) + record.payloadBytes;
+			}
+			recordsEnd = offset;
+		}
+
+		// false past the last whole record
+		bool readRecordHeader(uint64_t offset, RecordHeader& record)
+		{
+			if (offset + sizeof(RecordHeader) > recordsEnd) return false;
+			in.clear();
+			in.seekg(static_cast<std::streamoff>(offset));
+			if (!in.read(reinterpret_cast<char*>(&record), sizeof(record)))
+				return false;
+			if (record.kind != Keyframe && record.kind != Delta)
+				throw std::runtime_error("History: " + path + " is damaged");
+			return record.payloadBytes <= recordsEnd - offset - sizeof(RecordHeader);
+		}
+
+		// applies the record at offset to the board and moves past it
+		void applyRecord(uint64_t& offset, RecordHeader& record)
+		{
+			if (!readRecordHeader(offset, record))
+				throw std::runtime_error("History: " + path + " ends before generation " + std::to_string(record.generation + 1));
+			payload.resize(record.payloadBytes);
+			if (!in.read(reinterpret_cast<char*>(payload.data()), static_cast<std::streamsize>(payload.size())))
+				throw std::runtime_error("History: reading " + path + " failed");
+			if (record.kind == Keyframe)
+				std::fill(board.words.begin(), board.words.end(), 0);
+			apply(payload.data(), payload.size(), board.words.data(), board.words.size());
+			board.generation = record.generation;
+			offset += sizeof(RecordHeader) + record.payloadBytes;
+		}
+
+		const BitFrame& seek(uint64_t generation)
+		{
+			if (generation < header.firstGeneration || generation > lastGeneration)
+				throw std::out_of_range("History: generation " + std::to_string(generation) + " isn't in " + path + " (" + std::to_string(header.firstGeneration)
+					+ " to " + std::to_string(lastGeneration) + ")");
+
+			// nearest keyframe at or before it
+			size_t low = 0, high = keyframes.size();
+			while (high - low > 1)
+			{
+				size_t middle = (low + high) / 2;
+				if (keyframes[middle].generation <= generation)
+					low = middle;
+				else
+					high = middle;
+			}
+			const IndexEntry& keyframe = keyframes[low];
+
+			bool carryOn = haveBoard && board.generation <= generation && board.generation >= keyframe.generation;
+			uint64_t offset = carryOn ? nextOffset : keyframe.offset;
+			haveBoard = false; // until the board is whole again
+			RecordHeader record = { carryOn ? board.generation : keyframe.generation - 1, 0, 0, 0 };
+			if (!carryOn || board.generation != generation)
+			{
+				do
+				{
+					applyRecord(offset, record);
+				} while (record.generation < generation);
+			}
+			haveBoard = true;
+			nextOffset = offset;
+			return board;
+		}
+	};
+}
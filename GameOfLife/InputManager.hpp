@@ -1,12 +1,27 @@
 #pragma once
 #include <SFML/Graphics.hpp>
-#include "Grid.hpp"
+#include "Simulation.hpp"
+#include "Renderer.hpp"
+#include <algorithm>
+#include <memory>
+#include <string>
 
+// edits go through the simulation, which applies them on its own thread between generations
 struct InputManager
 {
-	Grid& grid;
+	Simulation& sim;
+	Renderer& renderer;
 
-	InputManager(Grid& grid) : grid(grid)
+	// right mouse button drags the camera
+	bool panning = false;
+	sf::Vector2i lastMouse;
+
+	int stepsPerFrame; // our copy of the simulation's setting, it is only changed through edits
+
+	// pattern picked in the browser, left clicks place it instead of toggling a tile until Escape
+	std::shared_ptr<const PatternIO::Pattern> stamp;
+
+	InputManager(Simulation& sim, Renderer& renderer) : sim(sim), renderer(renderer), stepsPerFrame(sim.stepsPerFrame)
 	{
 	}
 
@@ -21,6 +36,45 @@ struct InputManager
 
 				handleMouseClick(mouseX, mouseY);
 			}
+			else if (event.mouseButton.button == sf::Mouse::Right)
+			{
+				panning = true;
+				lastMouse = sf::Vector2i(event.mouseButton.x, event.mouseButton.y);
+			}
+		}
+
+		else if (event.type == sf::Event::MouseButtonReleased)
+		{
+			if (event.mouseButton.button == sf::Mouse::Right)
+				panning = false;
+		}
+
+		else if (event.type == sf::Event::MouseMoved)
+		{
+			if (panning)
+			{
+				sf::Vector2i mouse(event.mouseMove.x, event.mouseMove.y);
+				renderer.pan(mouse - lastMouse);
+				lastMouse = mouse;
+			}
+		}
+
+		else if (event.type == sf::Event::MouseWheelScrolled)
+		{
+			// scroll up zooms in around the cursor
+			float factor = event.mouseWheelScroll.delta > 0 ? 0.8f : 1.25f;
+			renderer.zoomAt(sf::Vector2i(event.mouseWheelScroll.x, event.mouseWheelScroll.y), factor);
+		}
+
+		else if (event.type == sf::Event::Resized)
+		{
+			renderer.onResize(event.size.width, event.size.height);
+		}
+
+		// some platforms lose the window contents while it's covered, draw it again when it comes back
+		else if (event.type == sf::Event::GainedFocus)
+		{
+			renderer.invalidate();
 		}
 		
 		else if (event.type == sf::Event::KeyPressed)
@@ -30,13 +84,31 @@ struct InputManager
 			
 	}
 
-	void handleMouseClick(int mouseX, int mouseY)
+	void setStepsPerFrame(int steps)
 	{
-		// calc cell indices based on mouse coords
-		int rowIdx = mouseX / tileSize;
-		int colIdx = mouseY / tileSize;
+		stepsPerFrame = steps;
+		sim.setStepsPerFrame(steps);
+	}
 
-		grid.tiles[rowIdx][colIdx].toggleState();
+	void setStamp(std::shared_ptr<const PatternIO::Pattern> pattern)
+	{
+		stamp = std::move(pattern);
+		if (stamp)
+			renderer.window.setTitle("GameOfLife - placing " + stamp->name + ", Escape to stop");
+		else
+			renderer.window.setTitle("GameOfLife");
+	}
+
+	void handleMouseClick(int mouseX, int mouseY)
+	{
+		// calc cell indices based on mouse coords, through the camera
+		int rowIdx, colIdx;
+		if (!renderer.pixelToTile(sf::Vector2i(mouseX, mouseY), rowIdx, colIdx))
+			return;
+		if (stamp)
+			sim.placePattern(rowIdx, colIdx, stamp);
+		else
+			sim.toggleTile(rowIdx, colIdx);
 	}
 
 	void handleKeyPress(sf::Keyboard::Key keyCode)
@@ -45,7 +117,81 @@ struct InputManager
 		{
 			// pause & unpause the grid update 
 			case sf::Keyboard::Space:
-				grid.gamePaused = !grid.gamePaused;
+				sim.togglePause();
+				break;
+
+			// stop placing the picked pattern
+			case sf::Keyboard::Escape:
+				if (stamp)
+					setStamp(nullptr);
+				break;
+
+			// switch between drawing tiles as squares and as texture pixels
+			case sf::Keyboard::T:
+				renderer.toggleMode();
+				break;
+
+			// step back a generation, or 64 with shift held, pauses first
+			case sf::Keyboard::Backspace:
+			{
+				bool shift = sf::Keyboard::isKeyPressed(sf::Keyboard::LShift) || sf::Keyboard::isKeyPressed(sf::Keyboard::RShift);
+				sim.stepBack(shift ? 64 : 1);
+				break;
+			}
+
+			// undo the last edit with control held, redo with shift as well (or control + Y), pauses first
+			case sf::Keyboard::Z:
+			case sf::Keyboard::Y:
+			{
+				bool control = sf::Keyboard::isKeyPressed(sf::Keyboard::LControl) || sf::Keyboard::isKeyPressed(sf::Keyboard::RControl);
+				bool shift = sf::Keyboard::isKeyPressed(sf::Keyboard::LShift) || sf::Keyboard::isKeyPressed(sf::Keyboard::RShift);
+				if (!control)
+					break;
+				if (keyCode == sf::Keyboard::Y || shift)
+					sim.redo();
+				else
+					sim.undo();
+				break;
+			}
+
+			// plain tiles or the cell-age heatmap
+			case sf::Keyboard::C:
+				renderer.toggleColorMode();
+				sim.setPublishAges(renderer.colorMode == ColorMode::Age);
+				break;
+
+			// move the camera a tenth of the screen at a time
+			case sf::Keyboard::Left:
+				renderer.pan(sf::Vector2i(static_cast<int>(renderer.window.getSize().x / 10), 0));
+				break;
+			case sf::Keyboard::Right:
+				renderer.pan(sf::Vector2i(-static_cast<int>(renderer.window.getSize().x / 10), 0));
+				break;
+			case sf::Keyboard::Up:
+				renderer.pan(sf::Vector2i(0, static_cast<int>(renderer.window.getSize().y / 10)));
+				break;
+			case sf::Keyboard::Down:
+				renderer.pan(sf::Vector2i(0, -static_cast<int>(renderer.window.getSize().y / 10)));
+				break;
+
+			// back to the unzoomed view
+			case sf::Keyboard::Home:
+				renderer.resetCamera();
+				break;
+
+			// hyperspeed, as many generations per frame as fit the frame budget
+			case sf::Keyboard::H:
+				setStepsPerFrame(stepsPerFrame == 1 ? 0 : 1);
+				break;
+
+			// fixed number of generations per frame, doubled or halved
+			case sf::Keyboard::Equal:
+			case sf::Keyboard::Add:
+				setStepsPerFrame(stepsPerFrame <= 1 ? 2 : std::min(stepsPerFrame * 2, maxGenerationsPerFrame));
+				break;
+			case sf::Keyboard::Hyphen:
+			case sf::Keyboard::Subtract:
+				setStepsPerFrame(stepsPerFrame <= 1 ? 1 : stepsPerFrame / 2);
 				break;
 		}
 	}
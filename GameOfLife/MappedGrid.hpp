@@ -0,0 +1,409 @@
+#pragma once
+#include "BitKernel.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// grid backend for boards that don't fit in RAM
+// the bit-packed board lives in a memory-mapped file and the os pages it in and out as we go
+// file layout: one page of header, then two planes (current and next generation) of bit-packed rows
+// update() streams through the board band by band so only a few bands need to be resident at a time
+
+struct MappedGridHeader
+{
+	char magic[4];
+	uint32_t version;
+	int32_t width;
+	int32_t height;
+	uint64_t wordsPerRow;
+	uint64_t generation;
+	uint32_t currentPlane; // which of the two planes holds the current generation
+};
+
+struct MappedGrid
+{
+	static constexpr uint32_t fileVersion = 1;
+	static constexpr size_t headerBytes = 4096;
+	static constexpr size_t bandBytes = 16u << 20; // rough amount of board stepped per band
+
+	int w;
+	int h;
+	bool gamePaused = true;
+	Rule rule;
+	bool countSteps = false; // fill lastStep with what every step did
+	BitKernel::StepCounts lastStep;
+
+	size_t wordsPerRow = 0;
+	size_t planeBytes = 0;
+	size_t fileBytes = 0;
+	int rowsPerBand = 1;
+
+	unsigned char* base = nullptr;
+	MappedGridHeader* header = nullptr;
+
+	// a generation handed to a background reader (see freeze), there's no spare plane to move it out of the way
+	// like ParallelGrid does (the board doesn't fit in RAM), so a step or edit that would overwrite it waits instead
+	std::atomic<bool> frozen{ false };
+	uint32_t frozenPlane = 0;
+
+#ifdef _WIN32
+	HANDLE fileHandle = INVALID_HANDLE_VALUE;
+	HANDLE mappingHandle = nullptr;
+#else
+	int fd = -1;
+#endif
+
+	// opens the board file at path, creating a dead board of width x height if it doesn't exist yet
+	MappedGrid(const std::string& path, int width, int height) : w(width), h(height)
+	{
+		if (w <= 0 || h <= 0)
+			throw std::invalid_argument("MappedGrid: board dimensions must be positive");
+		if (path.empty())
+			throw std::invalid_argument("MappedGrid: needs a board file to map (--board-file)");
+
+		wordsPerRow = BitKernel::wordsForWidth(w);
+		planeBytes = wordsPerRow * sizeof(uint64_t) * static_cast<size_t>(h);
+		fileBytes = headerBytes + 2 * planeBytes;
+
+		size_t rowBytes = wordsPerRow * sizeof(uint64_t);
+		rowsPerBand = static_cast<int>(bandBytes / rowBytes);
+		if (rowsPerBand < 1) rowsPerBand = 1;
+		if (rowsPerBand > h) rowsPerBand = h;
+
+		bool created = mapFile(path);
+
+		header = reinterpret_cast<MappedGridHeader*>(base);
+		if (created)
+		{
+			std::memcpy(header->magic, "GOLM", 4);
+			header->version = fileVersion;
+			header->width = w;
+			header->height = h;
+			header->wordsPerRow = wordsPerRow;
+			header->generation = 0;
+			header->currentPlane = 0;
+		}
+		else if (std::memcmp(header->magic, "GOLM", 4) != 0 || header->version != fileVersion
+			|| header->width != w || header->height != h || header->wordsPerRow != wordsPerRow)
+		{
+			unmapFile();
+			throw std::runtime_error("MappedGrid: " + path + " is not a board file of the requested size");
+		}
+	}
+
+	~MappedGrid()
+	{
+		unmapFile();
+	}
+
+	MappedGrid(const MappedGrid&) = delete;
+	MappedGrid& operator=(const MappedGrid&) = delete;
+
+	uint64_t generation() const
+	{
+		return header->generation;
+	}
+
+	uint64_t* plane(uint32_t index)
+	{
+		return reinterpret_cast<uint64_t*>(base + headerBytes + index * planeBytes);
+	}
+
+	uint64_t* currentPlane()
+	{
+		return plane(header->currentPlane);
+	}
+
+	uint64_t* row(int y)
+	{
+		return currentPlane() + static_cast<size_t>(y) * wordsPerRow;
+	}
+
+	bool isAlive(int x, int y)
+	{
+		return BitKernel::getBit(row(y), x);
+	}
+
+	void setAlive(int x, int y)
+	{
+		waitIfFrozen(header->currentPlane);
+		BitKernel::setBit(row(y), x, true);
+	}
+
+	void setDead(int x, int y)
+	{
+		waitIfFrozen(header->currentPlane);
+		BitKernel::setBit(row(y), x, false);
+	}
+
+	void toggleState(int x, int y)
+	{
+		waitIfFrozen(header->currentPlane);
+		BitKernel::setBit(row(y), x, !isAlive(x, y));
+	}
+
+	// the current generation's rows straight from the mapping for reading on another thread, the caller has
+	// to thaw() once done and the grid has to outlive that
+	// the next step still goes ahead (it writes the other plane), the one after that waits for the thaw
+	// only one generation can be frozen at a time, returns false while the last one is still being read
+	bool freeze(std::vector<const uint64_t*>& rows)
+	{
+		if (frozen.load(std::memory_order_acquire)) return false;
+		rows.resize(h);
+		for (int y = 0; y < h; y++)
+			rows[y] = row(y);
+		frozenPlane = header->currentPlane;
+		frozen.store(true, std::memory_order_release);
+		return true;
+	}
+
+	// any thread
+	void thaw()
+	{
+		frozen.store(false, std::memory_order_release);
+	}
+
+	// about to write into planeIndex, hold off while a reader still has it frozen
+	void waitIfFrozen(uint32_t planeIndex)
+	{
+		if (frozenPlane != planeIndex || !frozen.load(std::memory_order_acquire)) return;
+		while (frozen.load(std::memory_order_acquire))
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	uint64_t population()
+	{
+		uint64_t count = 0;
+		const uint64_t* words = currentPlane();
+		for (size_t n = 0; n < wordsPerRow * static_cast<size_t>(h); n++)
+			count += BitKernel::popcount(words[n]);
+		return count;
+	}
+
+	void update()
+	{
+		if (gamePaused) return;
+
+		waitIfFrozen(header->currentPlane ^ 1);
+		uint64_t* src = currentPlane();
+		uint64_t* dst = plane(header->currentPlane ^ 1);
+		lastStep = BitKernel::StepCounts();
+
+		// both planes are walked front to back, let the os read ahead and drop pages behind us
+		adviseSequential(src, planeBytes);
+		adviseSequential(dst, planeBytes);
+
+		for (int bandBegin = 0; bandBegin < h; bandBegin += rowsPerBand)
+		{
+			int bandEnd = bandBegin + rowsPerBand < h ? bandBegin + rowsPerBand : h;
+
+			// start paging in the next band while this one is stepped
+			if (bandEnd < h)
+			{
+				int nextEnd = bandEnd + rowsPerBand < h ? bandEnd + rowsPerBand : h;
+				adviseWillNeed(src + static_cast<size_t>(bandEnd) * wordsPerRow, static_cast<size_t>(nextEnd - bandEnd) * wordsPerRow * sizeof(uint64_t));
+			}
+
+			BitKernel::stepRows(src, dst, w, h, wordsPerRow, bandBegin, bandEnd, rule, countSteps ? &lastStep : nullptr);
+
+			// kick off write back of the finished band without waiting for it
+			flushAsync(dst + static_cast<size_t>(bandBegin) * wordsPerRow, static_cast<size_t>(bandEnd - bandBegin) * wordsPerRow * sizeof(uint64_t));
+
+			// the band above the previous one won't be read again this generation (except row 0 for wrap-around)
+			if (bandBegin >= 2 * rowsPerBand)
+			{
+				int doneBegin = bandBegin - 2 * rowsPerBand;
+				adviseDontNeed(src + static_cast<size_t>(doneBegin) * wordsPerRow, static_cast<size_t>(rowsPerBand) * wordsPerRow * sizeof(uint64_t));
+			}
+		}
+
+		header->currentPlane ^= 1;
+		header->generation++;
+		flushAsync(base, headerBytes);
+	}
+
+	void clear()
+	{
+		waitIfFrozen(header->currentPlane);
+		std::memset(currentPlane(), 0, planeBytes);
+	}
+
+	// page helpers, the ranges are widened to page boundaries since that's what the os works in
+	static size_t pageSize()
+	{
+#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return info.dwPageSize;
+#else
+		return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+	}
+
+	void pageRange(const void* addr, size_t length, unsigned char*& begin, size_t& bytes)
+	{
+		static const size_t page = pageSize();
+		uintptr_t start = reinterpret_cast<uintptr_t>(addr) & ~(static_cast<uintptr_t>(page) - 1);
+		uintptr_t end = reinterpret_cast<uintptr_t>(addr) + length;
+		begin = reinterpret_cast<unsigned char*>(start);
+		bytes = end - start;
+	}
+
+	void flushAsync(const void* addr, size_t length)
+	{
+		unsigned char* begin;
+		size_t bytes;
+		pageRange(addr, length, begin, bytes);
+#ifdef _WIN32
+		FlushViewOfFile(begin, bytes); // queues the dirty pages, doesn't wait for the disk
+#else
+		msync(begin, bytes, MS_ASYNC);
+#endif
+	}
+
+	void adviseSequential(const void* addr, size_t length)
+	{
+#ifndef _WIN32
+		unsigned char* begin;
+		size_t bytes;
+		pageRange(addr, length, begin, bytes);
+		madvise(begin, bytes, MADV_SEQUENTIAL);
+#else
+		(void)addr; (void)length;
+#endif
+	}
+
+	void adviseWillNeed(const void* addr, size_t length)
+	{
+#ifndef _WIN32
+		unsigned char* begin;
+		size_t bytes;
+		pageRange(addr, length, begin, bytes);
+		madvise(begin, bytes, MADV_WILLNEED);
+#else
+		(void)addr; (void)length;
+#endif
+	}
+
+	void adviseDontNeed(const void* addr, size_t length)
+	{
+#ifndef _WIN32
+		// safe on a shared file mapping, dirty data stays in the page cache and the file
+		unsigned char* begin;
+		size_t bytes;
+		pageRange(addr, length, begin, bytes);
+		madvise(begin, bytes, MADV_DONTNEED);
+#else
+		(void)addr; (void)length;
+#endif
+	}
+
+	// maps the file, returns true if it was freshly created
+	bool mapFile(const std::string& path)
+	{
+#ifdef _WIN32
+		fileHandle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (fileHandle == INVALID_HANDLE_VALUE)
+			throw std::runtime_error("MappedGrid: could not open " + path);
+		bool created = GetLastError() != ERROR_ALREADY_EXISTS;
+
+		// same as below, mapping an existing file of another size would grow it (or only map part of it)
+		LARGE_INTEGER existing;
+		if (!GetFileSizeEx(fileHandle, &existing))
+		{
+			unmapFile();
+			throw std::runtime_error("MappedGrid: could not read the size of " + path);
+		}
+		if (existing.QuadPart == 0)
+			created = true;
+		if (!created && static_cast<uint64_t>(existing.QuadPart) != fileBytes)
+		{
+			unmapFile();
+			throw std::runtime_error("MappedGrid: " + path + " is not a board file of the requested size");
+		}
+
+		LARGE_INTEGER size;
+		size.QuadPart = static_cast<LONGLONG>(fileBytes);
+		mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READWRITE, static_cast<DWORD>(size.HighPart), size.LowPart, nullptr);
+		if (!mappingHandle)
+		{
+			unmapFile();
+			throw std::runtime_error("MappedGrid: could not map " + path);
+		}
+		base = static_cast<unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, fileBytes));
+		if (!base)
+		{
+			unmapFile();
+			throw std::runtime_error("MappedGrid: could not map " + path);
+		}
+		return created;
+#else
+		fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		if (fd < 0)
+			throw std::runtime_error("MappedGrid: could not open " + path);
+
+		struct stat info;
+		fstat(fd, &info);
+		bool created = info.st_size == 0;
+
+		if (!created && static_cast<size_t>(info.st_size) != fileBytes)
+		{
+			unmapFile();
+			throw std::runtime_error("MappedGrid: " + path + " is not a board file of the requested size");
+		}
+
+		// grows the file sparsely, a fresh board costs no disk until cells are written
+		if (created && ftruncate(fd, static_cast<off_t>(fileBytes)) != 0)
+		{
+			unmapFile();
+			throw std::runtime_error("MappedGrid: could not size " + path);
+		}
+
+		void* mapped = mmap(nullptr, fileBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (mapped == MAP_FAILED)
+		{
+			unmapFile();
+			throw std::runtime_error("MappedGrid: could not map " + path);
+		}
+		base = static_cast<unsigned char*>(mapped);
+		return created;
+#endif
+	}
+
+	void unmapFile()
+	{
+#ifdef _WIN32
+		if (base) UnmapViewOfFile(base);
+		if (mappingHandle) CloseHandle(mappingHandle);
+		if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+		mappingHandle = nullptr;
+		fileHandle = INVALID_HANDLE_VALUE;
+#else
+		if (base) munmap(base, fileBytes);
+		if (fd >= 0) close(fd);
+		fd = -1;
+#endif
+		base = nullptr;
+		header = nullptr;
+	}
+};
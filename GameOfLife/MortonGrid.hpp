@@ -0,0 +1,272 @@
+#pragma once
+#include "BitKernel.hpp"
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// grid backend that stores the board as 8x8 cell tiles laid out in Z-order (Morton order)
+// a tile is one uint64_t, byte r holds row r of the tile and bit c of that byte is column c
+// the tiles are grouped in blocks of 2^k x 2^k (k = interleavedBits, at most maxInterleavedBits) stored in
+// Z-order inside, and the blocks are stored row by row, so tiles that are close in both x and y are close in
+// memory (the step reads its north/south neighbors from nearby cache lines) while the padding only rounds
+// each axis up to a whole block instead of both up to the next power of two
+// any size works, a board that isn't a multiple of 8 has its last tiles partly unused, and the tiles next to
+// the wrap-around seam are stepped from neighborhoods gathered cell by cell
+// the board wraps around like Grid
+
+struct MortonGrid
+{
+	static constexpr int tileCells = 8;
+	static constexpr int maxInterleavedBits = 4; // blocks of up to 16x16 tiles, 2KB
+
+	static constexpr uint64_t firstColumn = 0x0101010101010101ull;
+	static constexpr uint64_t lastColumn = 0x8080808080808080ull;
+
+	int w;
+	int h;
+	bool gamePaused = true;
+	Rule rule;
+	bool countSteps = false; // fill lastStep with what every step did
+	BitKernel::StepCounts lastStep;
+
+	int tilesX;
+	int tilesY;
+	int interleavedBits; // low bits of x and y that are interleaved inside a block
+	int blocksX; // blocks per row of blocks
+	size_t storedTiles;
+	bool seamX; // the width isn't a multiple of 8, the first and last column of tiles need the slow step
+	bool seamY;
+
+	std::vector<uint64_t> tiles;
+	std::vector<uint64_t> nextTiles;
+
+	MortonGrid(int width, int height) : w(width), h(height)
+	{
+		if (w <= 0 || h <= 0)
+			throw std::invalid_argument("MortonGrid: board dimensions must be positive");
+
+		tilesX = (w + tileCells - 1) / tileCells;
+		tilesY = (h + tileCells - 1) / tileCells;
+		seamX = w % tileCells != 0;
+		seamY = h % tileCells != 0;
+
+		// a block no bigger than the shorter axis, a 1000x8 board would mostly be padding otherwise
+		interleavedBits = bitsFor(tilesX < tilesY ? tilesX : tilesY);
+		if (interleavedBits > maxInterleavedBits) interleavedBits = maxInterleavedBits;
+		int blockTiles = 1 << interleavedBits;
+		blocksX = (tilesX + blockTiles - 1) / blockTiles;
+		int blocksY = (tilesY + blockTiles - 1) / blockTiles;
+		storedTiles = (static_cast<size_t>(blocksX) * blocksY) << (2 * interleavedBits);
+
+		tiles.assign(storedTiles, 0);
+		nextTiles.assign(storedTiles, 0);
+	}
+
+	static int bitsFor(int count)
+	{
+		int bits = 0;
+		while ((1 << bits) < count) bits++;
+		return bits;
+	}
+
+	// spreads the low 32 bits of v out to the even bit positions
+	static uint64_t spreadBits(uint64_t v)
+	{
+		v &= 0xffffffffull;
+		v = (v | (v << 16)) & 0x0000ffff0000ffffull;
+		v = (v | (v << 8)) & 0x00ff00ff00ff00ffull;
+		v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0full;
+		v = (v | (v << 2)) & 0x3333333333333333ull;
+		v = (v | (v << 1)) & 0x5555555555555555ull;
+		return v;
+	}
+
+	static uint64_t compactBits(uint64_t v)
+	{
+		v &= 0x5555555555555555ull;
+		v = (v | (v >> 1)) & 0x3333333333333333ull;
+		v = (v | (v >> 2)) & 0x0f0f0f0f0f0f0f0full;
+		v = (v | (v >> 4)) & 0x00ff00ff00ff00ffull;
+		v = (v | (v >> 8)) & 0x0000ffff0000ffffull;
+		v = (v | (v >> 16)) & 0x00000000ffffffffull;
+		return v;
+	}
+
+	// storage index of tile (tx, ty), the block's place in its row of blocks on top of the interleaved low bits
+	size_t tileIndex(int tx, int ty) const
+	{
+		uint64_t low = (static_cast<uint64_t>(1) << interleavedBits) - 1;
+		uint64_t block = static_cast<uint64_t>(ty >> interleavedBits) * blocksX + static_cast<uint64_t>(tx >> interleavedBits);
+		return static_cast<size_t>((block << (2 * interleavedBits)) | spreadBits(tx & low) | (spreadBits(ty & low) << 1));
+	}
+
+	void tileCoords(size_t index, int& tx, int& ty) const
+	{
+		uint64_t low = (static_cast<uint64_t>(1) << (2 * interleavedBits)) - 1;
+		uint64_t block = static_cast<uint64_t>(index) >> (2 * interleavedBits);
+		tx = static_cast<int>(compactBits(index & low) | ((block % blocksX) << interleavedBits));
+		ty = static_cast<int>(compactBits((index & low) >> 1) | ((block / blocksX) << interleavedBits));
+	}
+
+	uint64_t tile(int tx, int ty) const
+	{
+		return tiles[tileIndex(tx, ty)];
+	}
+
+	static int cellBit(int x, int y)
+	{
+		return (y % tileCells) * tileCells + (x % tileCells);
+	}
+
+	bool isAlive(int x, int y) const
+	{
+		return (tile(x / tileCells, y / tileCells) >> cellBit(x, y)) & 1;
+	}
+
+	void setState(int x, int y, bool alive)
+	{
+		uint64_t& t = tiles[tileIndex(x / tileCells, y / tileCells)];
+		uint64_t bit = 1ull << cellBit(x, y);
+		t = alive ? (t | bit) : (t & ~bit);
+	}
+
+	void setAlive(int x, int y)
+	{
+		setState(x, y, true);
+	}
+
+	void setDead(int x, int y)
+	{
+		setState(x, y, false);
+	}
+
+	void toggleState(int x, int y)
+	{
+		setState(x, y, !isAlive(x, y));
+	}
+
+	// moves each cell's west / east neighbor onto the cell's own bit, pulling the edge column from the next tile over
+	static uint64_t westOf(uint64_t center, uint64_t west)
+	{
+		return ((center << 1) & ~firstColumn) | ((west >> 7) & firstColumn);
+	}
+
+	static uint64_t eastOf(uint64_t center, uint64_t east)
+	{
+		return ((center >> 1) & ~lastColumn) | ((east << 7) & lastColumn);
+	}
+
+	// same for the north / south neighbors, rows are whole bytes
+	static uint64_t northOf(uint64_t center, uint64_t north)
+	{
+		return (center << 8) | (north >> 56);
+	}
+
+	static uint64_t southOf(uint64_t center, uint64_t south)
+	{
+		return (center >> 8) | (south << 56);
+	}
+
+	// next state of one tile from its 3x3 neighborhood, n[dy + 1][dx + 1]
+	static uint64_t stepTile(const uint64_t n[3][3], const Rule& rule)
+	{
+		uint64_t up[3], down[3];
+		for (int c = 0; c < 3; c++)
+		{
+			up[c] = northOf(n[1][c], n[0][c]);
+			down[c] = southOf(n[1][c], n[2][c]);
+		}
+
+		return BitKernel::nextWord(rule,
+			westOf(up[1], up[0]), up[1], eastOf(up[1], up[2]),
+			westOf(n[1][1], n[1][0]), n[1][1], eastOf(n[1][1], n[1][2]),
+			westOf(down[1], down[0]), down[1], eastOf(down[1], down[2]));
+	}
+
+	uint64_t population() const
+	{
+		uint64_t count = 0;
+		for (uint64_t t : tiles)
+			count += BitKernel::popcount(t);
+		return count;
+	}
+
+	void update()
+	{
+		if (gamePaused) return;
+
+		lastStep = BitKernel::StepCounts();
+
+		// walk the tiles in storage order so both the reads and the writes move through memory front to back
+		for (size_t index = 0; index < storedTiles; index++)
+		{
+			int tx, ty;
+			tileCoords(index, tx, ty);
+			if (tx >= tilesX || ty >= tilesY) continue; // padding up to a whole block
+
+			uint64_t n[3][3];
+			if ((seamX && (tx == 0 || tx == tilesX - 1)) || (seamY && (ty == 0 || ty == tilesY - 1)))
+			{
+				// the wrap-around seam runs through a tile, its neighbors aren't whole tiles
+				for (int dy = -1; dy <= 1; dy++)
+					for (int dx = -1; dx <= 1; dx++)
+						n[dy + 1][dx + 1] = gatherTile((tx + dx) * tileCells, (ty + dy) * tileCells);
+				nextTiles[index] = stepTile(n, rule) & usedCells(tx, ty);
+			}
+			else
+			{
+				for (int dy = -1; dy <= 1; dy++)
+				{
+					int ny = (ty + dy + tilesY) % tilesY;
+					for (int dx = -1; dx <= 1; dx++)
+					{
+						int nx = (tx + dx + tilesX) % tilesX;
+						n[dy + 1][dx + 1] = tiles[tileIndex(nx, ny)];
+					}
+				}
+				nextTiles[index] = stepTile(n, rule);
+			}
+			if (countSteps)
+				countTile(tx, ty, nextTiles[index], tiles[index]);
+		}
+		std::swap(tiles, nextTiles);
+	}
+
+	// the 8x8 cells from (x0, y0), wrapped around the board one cell at a time
+	uint64_t gatherTile(int x0, int y0) const
+	{
+		uint64_t t = 0;
+		for (int r = 0; r < tileCells; r++)
+		{
+			int y = ((y0 + r) % h + h) % h;
+			for (int c = 0; c < tileCells; c++)
+			{
+				int x = ((x0 + c) % w + w) % w;
+				if (isAlive(x, y))
+					t |= 1ull << (r * tileCells + c);
+			}
+		}
+		return t;
+	}
+
+	// bits of tile (tx, ty) that are on the board
+	uint64_t usedCells(int tx, int ty) const
+	{
+		int columns = w - tx * tileCells < tileCells ? w - tx * tileCells : tileCells;
+		int rows = h - ty * tileCells < tileCells ? h - ty * tileCells : tileCells;
+		uint64_t row = (1ull << columns) - 1;
+		uint64_t used = 0;
+		for (int r = 0; r < rows; r++)
+			used |= row << (r * tileCells);
+		return used;
+	}
+
+	// a byte of the tile is a row of 8 cells
+	void countTile(int tx, int ty, uint64_t next, uint64_t previous)
+	{
+		if ((next | previous) == 0) return;
+		for (int row = 0; row < tileCells; row++)
+			lastStep.add(static_cast<int64_t>(tx) * tileCells, static_cast<int64_t>(ty) * tileCells + row, (next >> (row * 8)) & 0xff, (previous >> (row * 8)) & 0xff);
+	}
+};
@@ -0,0 +1,489 @@
+#pragma once
+#include "BitKernel.hpp"
+#include "Checkpoint.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#endif
+
+// multithreaded bit-packed grid backend
+// each worker owns a fixed band of rows for the whole run: it first-touches the band's memory in both
+// planes when the grid is built (so on NUMA machines the pages land on the worker's node) and steps the
+// same band every generation after that
+// rows are padded to a multiple of 64 bytes and bands start on page boundaries, so neighboring workers
+// never write to the same cache line or page
+
+struct ParallelGridOptions
+{
+	int threads = 0; // 0 = one per hardware thread
+	bool pinThreads = false; // pin worker i to cpu i so the first-touch placement stays local
+	bool hugePages = false; // back the planes with huge pages where the os allows it
+	bool trackAges = false; // keep a CellAge byte per cell, stepped along with the board
+	bool countSteps = false; // fill lastStep with what every step did (see BitKernel::StepCounts)
+};
+
+struct ParallelGrid
+{
+	static constexpr size_t cacheLineBytes = 64;
+	static constexpr size_t hugePageBytes = 2u << 20;
+
+	int w;
+	int h;
+	bool gamePaused = true;
+	uint64_t generation = 0;
+	Rule rule;
+
+	ParallelGridOptions options;
+	size_t stride; // words per row including padding
+	size_t bandAlign; // bands start on multiples of this many bytes
+
+	struct Band
+	{
+		int rowBegin;
+		int rowEnd;
+		size_t byteOffset; // where the band starts inside a plane
+		size_t ageOffset; // and inside the age plane
+	};
+
+	// a plane of reservePlane'd memory, handed back by releasePlane when it goes, so a constructor that throws
+	// halfway doesn't leak the planes it already had
+	struct PlaneRelease
+	{
+		size_t bytes;
+
+		void operator()(unsigned char* plane) const
+		{
+			releasePlane(plane, bytes);
+		}
+	};
+	using Plane = std::unique_ptr<unsigned char, PlaneRelease>;
+
+	std::vector<Band> bands;
+	size_t planeBytes = 0;
+	Plane planes[2];
+	std::vector<uint64_t*> rowPointers[2];
+	int current = 0;
+
+	// each worker counts its own band on its own cache line, update() adds them up into lastStep
+	struct alignas(cacheLineBytes) BandCounts
+	{
+		BitKernel::StepCounts counts;
+	};
+	std::vector<BandCounts> bandCounts;
+	BitKernel::StepCounts lastStep;
+
+	// a resumed checkpoint, one plane's rows point into it (see adopt)
+	std::unique_ptr<Checkpoint::Mapping> checkpoint;
+
+	// a generation handed to a background reader (see freeze), the plane it lives in isn't written again
+	// until the reader thaws it: a step or edit that would overwrite it moves to the spare plane instead
+	// frozenSlot is 0 or 1 for rowPointers, 2 once the frozen rows were moved out to the spare
+	std::atomic<bool> frozen{ false };
+	int frozenSlot = -1;
+	Plane sparePlane; // only reserved the first time a reader is still busy
+	std::vector<uint64_t*> spareRows;
+	uint64_t planesDiverted = 0;
+
+	// one age byte per cell including the padding bits, 64 bytes per word, aged in place by the band's worker
+	size_t agePlaneBytes = 0;
+	Plane agePlane;
+	std::vector<uint8_t*> ageRows;
+
+	// worker pool, update() bumps stepGeneration and waits until every worker reported back
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable startStep;
+	std::condition_variable stepDone;
+	uint64_t stepGeneration = 0;
+	int workersDone = 0;
+	int workersReady = 0;
+	bool stopping = false;
+
+	ParallelGrid(int width, int height, ParallelGridOptions opts = ParallelGridOptions()) : w(width), h(height), options(opts)
+	{
+		if (w <= 0 || h <= 0)
+			throw std::invalid_argument("ParallelGrid: board dimensions must be positive");
+
+		int threads = options.threads > 0 ? options.threads : static_cast<int>(std::thread::hardware_concurrency());
+		if (threads < 1) threads = 1;
+		if (threads > h) threads = h;
+
+		size_t wordsPerLine = cacheLineBytes / sizeof(uint64_t);
+		stride = (BitKernel::wordsForWidth(w) + wordsPerLine - 1) / wordsPerLine * wordsPerLine;
+		bandAlign = options.hugePages ? hugePageBytes : pageSize();
+
+		// split the rows evenly, each band padded out to the alignment
+		size_t rowBytes = stride * sizeof(uint64_t);
+		size_t ageRowBytes = stride * 64;
+		size_t offset = 0;
+		size_t ageOffset = 0;
+		for (int i = 0; i < threads; i++)
+		{
+			Band band;
+			band.rowBegin = static_cast<int>(static_cast<int64_t>(h) * i / threads);
+			band.rowEnd = static_cast<int>(static_cast<int64_t>(h) * (i + 1) / threads);
+			band.byteOffset = offset;
+			band.ageOffset = ageOffset;
+			bands.push_back(band);
+
+			offset += static_cast<size_t>(band.rowEnd - band.rowBegin) * rowBytes;
+			offset = (offset + bandAlign - 1) / bandAlign * bandAlign;
+			ageOffset += static_cast<size_t>(band.rowEnd - band.rowBegin) * ageRowBytes;
+			ageOffset = (ageOffset + bandAlign - 1) / bandAlign * bandAlign;
+		}
+		planeBytes = offset;
+
+		for (int p = 0; p < 2; p++)
+		{
+			planes[p] = reservePlane(planeBytes);
+			rowPointers[p].resize(h);
+			for (const Band& band : bands)
+				for (int y = band.rowBegin; y < band.rowEnd; y++)
+					rowPointers[p][y] = reinterpret_cast<uint64_t*>(planes[p].get() + band.byteOffset + static_cast<size_t>(y - band.rowBegin) * rowBytes);
+		}
+
+		if (options.trackAges)
+		{
+			agePlaneBytes = ageOffset;
+			agePlane = reservePlane(agePlaneBytes);
+			ageRows.resize(h);
+			for (const Band& band : bands)
+				for (int y = band.rowBegin; y < band.rowEnd; y++)
+					ageRows[y] = agePlane.get() + band.ageOffset + static_cast<size_t>(y - band.rowBegin) * ageRowBytes;
+		}
+
+		bandCounts.resize(bands.size());
+
+		// the workers first-touch their own bands before anyone else writes to the board
+		try
+		{
+			for (int i = 0; i < threads; i++)
+				workers.emplace_back(&ParallelGrid::workerLoop, this, i);
+		}
+		catch (...)
+		{
+			stopWorkers(); // the ones that did start, the planes go with the members
+			throw;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		stepDone.wait(lock, [&] { return workersReady == static_cast<int>(workers.size()); });
+	}
+
+	~ParallelGrid()
+	{
+		stopWorkers();
+	}
+
+	ParallelGrid(const ParallelGrid&) = delete;
+	ParallelGrid& operator=(const ParallelGrid&) = delete;
+
+	uint64_t* row(int y)
+	{
+		return rowPointers[current][y];
+	}
+
+	bool isAlive(int x, int y)
+	{
+		return BitKernel::getBit(row(y), x);
+	}
+
+	void setCell(int x, int y, bool alive)
+	{
+		divertIfFrozen(current, true);
+		if (isAlive(x, y) == alive) return;
+		BitKernel::setBit(row(y), x, alive);
+		if (agePlane)
+			ageRows[y][x] = 0;
+	}
+
+	void setAlive(int x, int y)
+	{
+		setCell(x, y, true);
+	}
+
+	void setDead(int x, int y)
+	{
+		setCell(x, y, false);
+	}
+
+	void toggleState(int x, int y)
+	{
+		setCell(x, y, !isAlive(x, y));
+	}
+
+	// resumes from a checkpoint without reading it: the current plane's rows are pointed at the mapped file,
+	// pages come in as the workers first step over them and the first writes to them copy them privately
+	// the rows have the same padded layout as ours, so nothing needs converting
+	void adopt(std::unique_ptr<Checkpoint::Mapping> mapping)
+	{
+		const Checkpoint::Header& header = mapping->header();
+		if (header.width != w || header.height != h || header.wordsPerRow != stride)
+			throw std::invalid_argument("ParallelGrid: checkpoint " + mapping->path + " is for a different board size");
+
+		for (int y = 0; y < h; y++)
+			rowPointers[current][y] = mapping->row(y);
+		discardPlane(planes[current].get(), planeBytes); // our own copy of that plane isn't used anymore
+
+		generation = header.generation;
+		rule = Checkpoint::ruleOf(header);
+		checkpoint = std::move(mapping);
+	}
+
+	// the current generation's rows for reading on another thread while the simulation carries on, no cells
+	// are copied, the caller has to thaw() once done and the grid has to outlive that
+	// only one generation can be frozen at a time, returns false while the last one is still being read
+	bool freeze(std::vector<const uint64_t*>& rows)
+	{
+		if (frozen.load(std::memory_order_acquire)) return false;
+		rows.assign(rowPointers[current].begin(), rowPointers[current].end());
+		frozenSlot = current;
+		frozen.store(true, std::memory_order_release);
+		return true;
+	}
+
+	// any thread
+	void thaw()
+	{
+		frozen.store(false, std::memory_order_release);
+	}
+
+	// about to write into slot's plane, if that's frozen the frozen rows trade places with the spare plane's
+	// so the reader keeps them untouched, keepContents copies the board over first (only edits need that,
+	// a step overwrites every row anyway)
+	void divertIfFrozen(int slot, bool keepContents)
+	{
+		if (frozenSlot != slot) return;
+		if (!frozen.load(std::memory_order_acquire))
+		{
+			frozenSlot = -1;
+			return;
+		}
+
+		if (!sparePlane)
+		{
+			// first touched by the workers stepping into it, so its pages land next to them like the others
+			sparePlane = reservePlane(planeBytes);
+			spareRows.resize(h);
+			size_t rowBytes = stride * sizeof(uint64_t);
+			for (const Band& band : bands)
+				for (int y = band.rowBegin; y < band.rowEnd; y++)
+					spareRows[y] = reinterpret_cast<uint64_t*>(sparePlane.get() + band.byteOffset + static_cast<size_t>(y - band.rowBegin) * rowBytes);
+		}
+		if (keepContents)
+			for (int y = 0; y < h; y++)
+				std::memcpy(spareRows[y], rowPointers[slot][y], stride * sizeof(uint64_t));
+
+		std::swap(rowPointers[slot], spareRows);
+		std::swap(planes[slot], sparePlane);
+		frozenSlot = 2;
+		planesDiverted++;
+	}
+
+	// only there with options.trackAges
+	uint8_t* ageRow(int y)
+	{
+		return ageRows[y];
+	}
+
+	uint8_t age(int x, int y)
+	{
+		return ageRows[y][x];
+	}
+
+	uint64_t population()
+	{
+		uint64_t count = 0;
+		size_t words = BitKernel::wordsForWidth(w);
+		for (int y = 0; y < h; y++)
+			for (size_t n = 0; n < words; n++)
+				count += BitKernel::popcount(row(y)[n]);
+		return count;
+	}
+
+	void update()
+	{
+		if (gamePaused) return;
+		divertIfFrozen(current ^ 1, false);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		workersDone = 0;
+		stepGeneration++;
+		startStep.notify_all();
+		stepDone.wait(lock, [&] { return workersDone == static_cast<int>(workers.size()); });
+
+		current ^= 1;
+		generation++;
+
+		if (options.countSteps)
+		{
+			lastStep = BitKernel::StepCounts();
+			for (const BandCounts& band : bandCounts)
+				lastStep.merge(band.counts);
+		}
+	}
+
+	void workerLoop(int index)
+	{
+		if (options.pinThreads)
+			pinCurrentThread(index);
+
+		// first touch, zeroing the band faults its pages in on this thread's node
+		const Band& band = bands[index];
+		size_t bandBytes = static_cast<size_t>(band.rowEnd - band.rowBegin) * stride * sizeof(uint64_t);
+		for (int p = 0; p < 2; p++)
+			std::memset(planes[p].get() + band.byteOffset, 0, bandBytes);
+		if (agePlane)
+			std::memset(agePlane.get() + band.ageOffset, CellAge::maxAge, bandBytes * 8); // a byte per bit
+
+		uint64_t seen = 0;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			workersReady++;
+		}
+		stepDone.notify_all();
+
+		size_t words = BitKernel::wordsForWidth(w);
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				startStep.wait(lock, [&] { return stopping || stepGeneration != seen; });
+				if (stopping) return;
+				seen = stepGeneration;
+			}
+
+			const std::vector<uint64_t*>& src = rowPointers[current];
+			const std::vector<uint64_t*>& dst = rowPointers[current ^ 1];
+			BitKernel::StepCounts* counts = nullptr;
+			if (options.countSteps)
+			{
+				counts = &bandCounts[index].counts;
+				*counts = BitKernel::StepCounts();
+			}
+			for (int y = band.rowBegin; y < band.rowEnd; y++)
+			{
+				int yUp = (y + h - 1) % h;
+				int yDown = (y + 1) % h;
+				BitKernel::stepRow(src[yUp], src[y], src[yDown], dst[y], words, w, rule, agePlane ? ageRows[y] : nullptr, counts, y);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				workersDone++;
+			}
+			stepDone.notify_all();
+		}
+	}
+
+	static size_t pageSize()
+	{
+#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return info.dwPageSize;
+#else
+		return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+	}
+
+	static void pinCurrentThread(int index)
+	{
+		unsigned cpus = std::thread::hardware_concurrency();
+		int cpu = cpus > 0 ? index % static_cast<int>(cpus) : index;
+#if defined(_WIN32)
+		SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << (cpu % (8 * sizeof(DWORD_PTR))));
+#elif defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu % CPU_SETSIZE, &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+		(void)cpu;
+#endif
+	}
+
+	void stopWorkers()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		startStep.notify_all();
+		for (std::thread& worker : workers)
+			worker.join();
+		workers.clear();
+	}
+
+	// reserves address space without touching it, so the pages get placed by whoever writes them first
+	Plane reservePlane(size_t bytes)
+	{
+		void* memory = nullptr;
+#ifdef _WIN32
+		if (options.hugePages)
+		{
+			// needs the lock pages privilege, quietly fall back to normal pages without it
+			size_t large = GetLargePageMinimum();
+			if (large > 0 && bytes % large == 0)
+				memory = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		}
+		if (!memory)
+			memory = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		if (!memory)
+			throw std::bad_alloc();
+#else
+		memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (memory == MAP_FAILED)
+			throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+		if (options.hugePages)
+			madvise(memory, bytes, MADV_HUGEPAGE);
+#endif
+#endif
+		return Plane(static_cast<unsigned char*>(memory), PlaneRelease{ bytes });
+	}
+
+	// gives the memory back to the os but keeps the address range
+	static void discardPlane(unsigned char* plane, size_t bytes)
+	{
+#ifdef _WIN32
+		VirtualAlloc(plane, bytes, MEM_RESET, PAGE_READWRITE);
+#else
+		madvise(plane, bytes, MADV_DONTNEED);
+#endif
+	}
+
+	static void releasePlane(unsigned char* plane, size_t bytes)
+	{
+		if (!plane) return;
+#ifdef _WIN32
+		(void)bytes;
+		VirtualFree(plane, 0, MEM_RELEASE);
+#else
+		munmap(plane, bytes);
+#endif
+	}
+};
@@ -0,0 +1,253 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include "PatternLibrary.hpp"
+#include "SoftwareRenderer.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// a page of thumbnails over a PatternLibrary that takes over the window while it's open (L in the game)
+// thumbnails show up as the library's workers get to them, whatever page is on screen is done first
+// scroll with the wheel, the arrow keys or page up / down, a click picks a pattern, Escape or L closes it
+// there's no font to draw with, the name, size, population and rule of the pattern under the mouse (and how
+// far the indexing got) go in the window title
+struct PatternBrowser
+{
+    static constexpr int slotPixels = 144; // square per pattern, the thumbnail scaled to fit with a margin
+    static constexpr int marginPixels = 8;
+    static constexpr int maxScale = 16; // screen pixels per thumbnail pixel, for tiny patterns
+
+    // a thumbnail on screen, rebuilt when the slot shows another entry or its entry got indexed
+    struct Slot
+    {
+        size_t entry = SIZE_MAX;
+        int state = PatternLibrary::Pending;
+        sf::Texture texture;
+        sf::Sprite sprite;
+    };
+
+    PatternLibrary& library;
+    sf::RenderWindow& window;
+    bool open = false;
+    size_t first = 0; // entry in the top left slot, always the start of a row
+    size_t hovered = SIZE_MAX;
+
+    std::vector<Slot> slots;
+    SoftwareRenderer thumbnails;
+    Image image;
+    std::vector<sf::Uint8> rgba;
+
+    bool dirty = true;
+    size_t drawnIndexed = 0; // library.indexed when the page was last drawn
+    std::string title;
+
+    PatternBrowser(PatternLibrary& lib, sf::RenderWindow& win) : library(lib), window(win), thumbnails(thumbnailOptions())
+    {
+    }
+
+    static RasterOptions thumbnailOptions()
+    {
+        RasterOptions options;
+        options.gridLines = false;
+        options.threads = 1;
+        return options;
+    }
+
+    size_t columns() const
+    {
+        return std::max<size_t>(1, window.getSize().x / slotPixels);
+    }
+
+    size_t rows() const
+    {
+        return std::max<size_t>(1, window.getSize().y / slotPixels);
+    }
+
+    size_t pageSize() const
+    {
+        return columns() * rows();
+    }
+
+    void toggle()
+    {
+        open = !open;
+        dirty = true;
+        hovered = SIZE_MAX;
+        if (!open)
+            library.focus(0, 0);
+    }
+
+    // new thumbnails came in or the page changed
+    bool needsRedraw() const
+    {
+        return dirty || library.indexed != drawnIndexed;
+    }
+
+    void scrollRows(int64_t delta)
+    {
+        size_t perRow = columns();
+        size_t lastRow = library.size() > 0 ? (library.size() - 1) / perRow : 0;
+        int64_t row = static_cast<int64_t>(first / perRow) + delta;
+        row = std::max<int64_t>(0, std::min<int64_t>(row, static_cast<int64_t>(lastRow)));
+        first = static_cast<size_t>(row) * perRow;
+        dirty = true;
+    }
+
+    // entry under a window pixel, SIZE_MAX if there's none
+    size_t entryAt(int x, int y) const
+    {
+        if (x < 0 || y < 0) return SIZE_MAX;
+        size_t column = static_cast<size_t>(x) / slotPixels, row = static_cast<size_t>(y) / slotPixels;
+        if (column >= columns() || row >= rows()) return SIZE_MAX;
+        size_t index = first + row * columns() + column;
+        return index < library.size() ? index : SIZE_MAX;
+    }
+
+    // returns true and sets picked when a pattern was clicked, the browser closes then
+    bool handleEvent(const sf::Event& event, size_t& picked)
+    {
+        if (event.type == sf::Event::MouseWheelScrolled)
+        {
+            scrollRows(event.mouseWheelScroll.delta > 0 ? -1 : 1);
+        }
+        else if (event.type == sf::Event::MouseMoved)
+        {
+            size_t index = entryAt(event.mouseMove.x, event.mouseMove.y);
+            if (index != hovered)
+            {
+                hovered = index;
+                dirty = true;
+            }
+        }
+        else if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left)
+        {
+            size_t index = entryAt(event.mouseButton.x, event.mouseButton.y);
+            if (index != SIZE_MAX && library.entries[index].state.load(std::memory_order_acquire) == PatternLibrary::Ready)
+            {
+                picked = index;
+                toggle();
+                return true;
+            }
+        }
+        else if (event.type == sf::Event::Resized || event.type == sf::Event::GainedFocus)
+        {
+            scrollRows(0); // keeps first at the start of a row for the new width
+        }
+        else if (event.type == sf::Event::KeyPressed)
+        {
+            switch (event.key.code)
+            {
+                case sf::Keyboard::Escape:
+                case sf::Keyboard::L:
+                    toggle();
+                    break;
+                case sf::Keyboard::Up:
+                    scrollRows(-1);
+                    break;
+                case sf::Keyboard::Down:
+                    scrollRows(1);
+                    break;
+                case sf::Keyboard::PageUp:
+                    scrollRows(-static_cast<int64_t>(rows()));
+                    break;
+                case sf::Keyboard::PageDown:
+                    scrollRows(static_cast<int64_t>(rows()));
+                    break;
+                case sf::Keyboard::Home:
+                    first = 0;
+                    dirty = true;
+                    break;
+                default:
+                    break;
+            }
+        }
+        return false;
+    }
+
+    void draw()
+    {
+        sf::Vector2u size = window.getSize();
+        window.setView(sf::View(sf::FloatRect(0.f, 0.f, static_cast<float>(size.x), static_cast<float>(size.y))));
+        window.clear(sf::Color(24, 24, 24));
+
+        size_t count = pageSize();
+        library.focus(first, count);
+        drawnIndexed = library.indexed; // before looking at the entries, one finishing meanwhile gets another draw
+        slots.resize(count);
+
+        for (size_t k = 0; k < count && first + k < library.size(); k++)
+        {
+            size_t index = first + k;
+            const PatternLibrary::Entry& entry = library.entries[index];
+            int state = entry.state.load(std::memory_order_acquire);
+            float x = static_cast<float>((k % columns()) * slotPixels), y = static_cast<float>((k / columns()) * slotPixels);
+
+            sf::RectangleShape frame(sf::Vector2f(slotPixels - marginPixels / 2.f, slotPixels - marginPixels / 2.f));
+            frame.setPosition(x + marginPixels / 4.f, y + marginPixels / 4.f);
+            frame.setFillColor(state == PatternLibrary::Failed ? sf::Color(72, 24, 24) : sf::Color(40, 40, 40));
+            frame.setOutlineThickness(index == hovered ? 2.f : 0.f);
+            frame.setOutlineColor(sf::Color(200, 200, 200));
+            window.draw(frame);
+
+            if (state != PatternLibrary::Ready) continue;
+            Slot& slot = slots[k];
+            if (slot.entry != index || slot.state != state)
+                buildSlot(slot, index, state);
+            slot.sprite.setPosition(x + (slotPixels - slot.sprite.getGlobalBounds().width) / 2, y + (slotPixels - slot.sprite.getGlobalBounds().height) / 2);
+            window.draw(slot.sprite);
+        }
+        window.display();
+        dirty = false;
+        updateTitle();
+    }
+
+    void buildSlot(Slot& slot, size_t index, int state)
+    {
+        const BitFrame& thumbnail = library.entries[index].thumbnail;
+        slot.entry = index;
+        slot.state = state;
+
+        thumbnails.render(thumbnail, image);
+        rgba.resize(static_cast<size_t>(image.width) * image.height * 4);
+        for (size_t p = 0, count = static_cast<size_t>(image.width) * image.height; p < count; p++)
+        {
+            rgba[p * 4] = image.pixels[p * 3];
+            rgba[p * 4 + 1] = image.pixels[p * 3 + 1];
+            rgba[p * 4 + 2] = image.pixels[p * 3 + 2];
+            rgba[p * 4 + 3] = 255;
+        }
+        slot.texture.create(std::max(1, image.width), std::max(1, image.height));
+        if (!rgba.empty())
+            slot.texture.update(rgba.data());
+        slot.sprite.setTexture(slot.texture, true);
+
+        int side = std::max(1, std::max(image.width, image.height));
+        float scale = static_cast<float>(std::max(1, std::min(maxScale, (slotPixels - 2 * marginPixels) / side)));
+        slot.sprite.setScale(scale, scale);
+    }
+
+    void updateTitle()
+    {
+        std::string text = "GameOfLife - patterns";
+        if (library.busy())
+            text += " (indexed " + std::to_string(library.indexed.load()) + " of " + std::to_string(library.size()) + ")";
+        if (hovered != SIZE_MAX)
+        {
+            const PatternLibrary::Entry& entry = library.entries[hovered];
+            int state = entry.state.load(std::memory_order_acquire);
+            if (state == PatternLibrary::Ready)
+                text += " - " + entry.name + ", " + std::to_string(entry.width) + "x" + std::to_string(entry.height) + ", population "
+                    + std::to_string(entry.population) + (entry.hasRule ? ", " + entry.rule.toString() : "");
+            else if (state == PatternLibrary::Failed)
+                text += " - " + entry.path + " can't be read";
+            else
+                text += " - " + entry.path;
+        }
+        if (text != title)
+        {
+            title = text;
+            window.setTitle(title);
+        }
+    }
+};
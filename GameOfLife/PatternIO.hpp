@@ -0,0 +1,592 @@
+#pragma once
+#include "QuadTree.hpp"
+#include "Rule.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <istream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// reading and writing pattern files
+// plaintext .cells: lines starting with ! are comments, O (or *) is a live cell, anything else is dead
+// golly's run length encoded .rle: # comment lines, an "x = W, y = H, rule = B3/S23" header, then runs like
+// 3o2b$ (count, b dead / o alive, $ next row) up to a !, big patterns are streamed instead of loaded whole
+// golly's macrocell .mc: a QuadTree written out node by node, each line is an 8x8 leaf (. dead, * alive,
+// $ ends a row) or "level nw ne sw se" pointing at earlier lines, shared nodes are only written once
+
+namespace PatternIO
+{
+	struct Pattern
+	{
+		std::string name;
+		int64_t width = 0; // bounding box of the live cells (the header's size for .rle), cells are relative to its top left
+		int64_t height = 0;
+		std::vector<std::pair<int64_t, int64_t>> cells;
+
+		bool hasRule = false; // the file named a rule
+		Rule rule;
+		std::vector<std::string> comments; // rle comment lines other than the name, kept as written
+	};
+
+	inline bool hasExtension(const std::string& path, const std::string& extension)
+	{
+		if (path.size() < extension.size()) return false;
+		for (size_t n = 0; n < extension.size(); n++)
+		{
+			char c = path[path.size() - extension.size() + n];
+			if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+			if (c != extension[n]) return false;
+		}
+		return true;
+	}
+
+	// shifts the cells so the bounding box starts at 0, 0 and records its size
+	inline void normalize(Pattern& pattern)
+	{
+		if (pattern.cells.empty()) return;
+
+		int64_t minX = pattern.cells[0].first, maxX = minX;
+		int64_t minY = pattern.cells[0].second, maxY = minY;
+		for (const auto& cell : pattern.cells)
+		{
+			if (cell.first < minX) minX = cell.first;
+			if (cell.first > maxX) maxX = cell.first;
+			if (cell.second < minY) minY = cell.second;
+			if (cell.second > maxY) maxY = cell.second;
+		}
+		for (auto& cell : pattern.cells)
+		{
+			cell.first -= minX;
+			cell.second -= minY;
+		}
+		pattern.width = maxX - minX + 1;
+		pattern.height = maxY - minY + 1;
+	}
+
+	inline Pattern readCells(std::istream& in)
+	{
+		Pattern pattern;
+		std::string line;
+		int64_t y = 0;
+		while (std::getline(in, line))
+		{
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			if (!line.empty() && line[0] == '!')
+			{
+				if (line.compare(0, 7, "!Name: ") == 0)
+					pattern.name = line.substr(7);
+				continue;
+			}
+			for (size_t x = 0; x < line.size(); x++)
+				if (line[x] == 'O' || line[x] == '*')
+					pattern.cells.emplace_back(static_cast<int64_t>(x), y);
+			y++;
+		}
+		normalize(pattern);
+		return pattern;
+	}
+
+	// writes the width x height region starting at (x0, y0), isAlive(x, y) is asked for every cell
+	template <typename IsAlive>
+	void writeCells(std::ostream& out, int64_t x0, int64_t y0, int64_t width, int64_t height, IsAlive isAlive, const std::string& name = "")
+	{
+		if (!name.empty())
+			out << "!Name: " << name << '\n';
+
+		std::string line;
+		for (int64_t y = y0; y < y0 + height; y++)
+		{
+			line.clear();
+			size_t used = 0; // trailing dead cells are left off
+			for (int64_t x = x0; x < x0 + width; x++)
+			{
+				bool alive = isAlive(x, y);
+				line += alive ? 'O' : '.';
+				if (alive) used = line.size();
+			}
+			line.resize(used);
+			out << line << '\n';
+		}
+	}
+
+	// streaming .rle reader, the constructor reads the comments and the header so the size (and rule) is
+	// known before any cells arrive, readCells then hands out each run of live cells as it is decoded
+	// the file goes through a fixed size buffer and no line is ever held whole, so memory use stays the
+	// same for a multi gigabyte pattern
+	struct RleReader
+	{
+		static constexpr size_t bufferBytes = 1 << 16;
+		static constexpr size_t maxCommentLength = 4096; // longer comment lines are cut off
+
+		std::istream& in;
+		Pattern header; // everything but the cells
+		std::vector<char> buffer;
+		size_t position = 0;
+		size_t filled = 0;
+
+		RleReader(std::istream& input) : in(input), buffer(bufferBytes)
+		{
+			readHeader();
+		}
+
+		int next()
+		{
+			if (position == filled)
+			{
+				in.read(buffer.data(), buffer.size());
+				filled = static_cast<size_t>(in.gcount());
+				position = 0;
+				if (filled == 0) return EOF;
+			}
+			return static_cast<unsigned char>(buffer[position++]);
+		}
+
+		int peek()
+		{
+			int c = next();
+			if (c != EOF) position--;
+			return c;
+		}
+
+		// rest of the current line, at most maxCommentLength characters of it are kept
+		std::string readLine()
+		{
+			std::string line;
+			for (int c = next(); c != EOF && c != '\n'; c = next())
+				if (c != '\r' && line.size() < maxCommentLength)
+					line += static_cast<char>(c);
+			return line;
+		}
+
+		static std::string trim(const std::string& text)
+		{
+			size_t begin = text.find_first_not_of(" \t");
+			if (begin == std::string::npos) return "";
+			size_t end = text.find_last_not_of(" \t");
+			return text.substr(begin, end - begin + 1);
+		}
+
+		void readHeader()
+		{
+			while (true)
+			{
+				int c = peek();
+				if (c == EOF)
+					throw std::runtime_error("PatternIO: rle file has no \"x = .., y = ..\" header");
+				if (c == '\n' || c == '\r' || c == ' ' || c == '\t')
+				{
+					next();
+					continue;
+				}
+
+				std::string line = readLine();
+				if (c == '#')
+				{
+					// #N is the name, #C / #c comments, #O the author, #P / #R offsets, all kept for writing back
+					if (line.size() >= 2 && line[1] == 'N')
+						header.name = trim(line.substr(2));
+					else
+						header.comments.push_back(line);
+					continue;
+				}
+				parseSizeLine(line);
+				return;
+			}
+		}
+
+		// "x = 3, y = 3, rule = B3/S23", the rule is optional
+		void parseSizeLine(const std::string& line)
+		{
+			bool hasX = false, hasY = false;
+			size_t start = 0;
+			while (start <= line.size())
+			{
+				size_t comma = line.find(',', start);
+				if (comma == std::string::npos) comma = line.size();
+				std::string item = line.substr(start, comma - start);
+				start = comma + 1;
+
+				size_t equals = item.find('=');
+				if (equals == std::string::npos) continue;
+				std::string key = trim(item.substr(0, equals));
+				std::string value = trim(item.substr(equals + 1));
+
+				if (key == "x" || key == "y")
+				{
+					size_t used = 0;
+					long long parsed = -1;
+					try
+					{
+						parsed = std::stoll(value, &used);
+					}
+					catch (const std::exception&)
+					{
+					}
+					if (parsed < 0 || used != value.size())
+						throw std::runtime_error("PatternIO: bad rle size \"" + item + "\"");
+					(key == "x" ? header.width : header.height) = parsed;
+					(key == "x" ? hasX : hasY) = true;
+				}
+				else if (key == "rule")
+				{
+					// golly adds the bounded grid after a colon (B3/S23:T100,100), the board decides that here
+					header.rule = Rule::parse(value.substr(0, value.find(':')));
+					header.hasRule = true;
+				}
+			}
+			if (!hasX || !hasY)
+				throw std::runtime_error("PatternIO: rle header needs x and y, got \"" + line + "\"");
+		}
+
+		// calls aliveRun(x, y, length) for every run of live cells, relative to the pattern's top left
+		template <typename AliveRun>
+		void readCells(AliveRun aliveRun)
+		{
+			const int64_t maxCount = int64_t(1) << 40;
+			int64_t x = 0, y = 0, count = 0;
+			for (int c = next(); c != EOF; c = next())
+			{
+				if (c >= '0' && c <= '9')
+				{
+					count = count * 10 + (c - '0');
+					if (count > maxCount)
+						throw std::runtime_error("PatternIO: rle run length too long");
+					continue;
+				}
+				if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+					continue;
+
+				int64_t length = count > 0 ? count : 1;
+				count = 0;
+
+				if (c == 'b' || c == '.')
+				{
+					x += length;
+				}
+				else if (c == '$')
+				{
+					y += length;
+					x = 0;
+				}
+				else if (c == '!')
+				{
+					return;
+				}
+				else if (c == '#')
+				{
+					readLine(); // stray comment inside the cells
+				}
+				else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+				{
+					// o, or any other state of a multi-state file, counts as alive
+					if (x + length > header.width || y >= header.height)
+						throw std::runtime_error("PatternIO: rle cells outside the x, y size in the header");
+					aliveRun(x, y, length);
+					x += length;
+				}
+				else
+				{
+					throw std::runtime_error(std::string("PatternIO: unexpected '") + static_cast<char>(c) + "' in rle cells");
+				}
+			}
+		}
+	};
+
+	inline Pattern readRle(std::istream& in)
+	{
+		RleReader reader(in);
+		Pattern pattern = reader.header;
+		reader.readCells([&](int64_t x, int64_t y, int64_t length)
+		{
+			for (int64_t k = 0; k < length; k++)
+				pattern.cells.emplace_back(x + k, y);
+		});
+		return pattern;
+	}
+
+	// groups the output into lines of at most 70 characters like golly does
+	struct RleWriter
+	{
+		static constexpr size_t lineLength = 70;
+
+		std::ostream& out;
+		size_t column = 0;
+
+		RleWriter(std::ostream& output) : out(output) {}
+
+		void run(int64_t length, char tag)
+		{
+			char token[24];
+			int size = length == 1 ? std::snprintf(token, sizeof(token), "%c", tag)
+				: std::snprintf(token, sizeof(token), "%lld%c", static_cast<long long>(length), tag);
+			if (column + size > lineLength)
+			{
+				out << '\n';
+				column = 0;
+			}
+			out.write(token, size);
+			column += size;
+		}
+	};
+
+	// same region and isAlive as writeCells, written one run at a time
+	template <typename IsAlive>
+	void writeRle(std::ostream& out, int64_t x0, int64_t y0, int64_t width, int64_t height, IsAlive isAlive, const std::string& name = "", const Rule& rule = Rule(),
+		const std::vector<std::string>& comments = {})
+	{
+		if (!name.empty())
+			out << "#N " << name << '\n';
+		for (const std::string& comment : comments)
+			out << comment << '\n';
+		out << "x = " << width << ", y = " << height << ", rule = " << rule.toString() << '\n';
+
+		RleWriter writer(out);
+		int64_t pendingRows = 0; // row ends not written yet, empty rows just add to this
+		for (int64_t y = y0; y < y0 + height; y++)
+		{
+			if (y > y0) pendingRows++;
+			int64_t deadRun = 0;
+			int64_t aliveRun = 0;
+			for (int64_t x = x0; x <= x0 + width; x++)
+			{
+				bool alive = x < x0 + width && isAlive(x, y);
+				if (alive)
+				{
+					aliveRun++;
+					continue;
+				}
+				if (aliveRun > 0)
+				{
+					if (pendingRows > 0)
+						writer.run(pendingRows, '$');
+					pendingRows = 0;
+					if (deadRun > 0)
+						writer.run(deadRun, 'b');
+					writer.run(aliveRun, 'o');
+					deadRun = 0;
+					aliveRun = 0;
+				}
+				deadRun++; // trailing dead cells are left off
+			}
+		}
+		writer.run(1, '!');
+		out << '\n';
+	}
+
+	// a macrocell file as a tree, nothing gets expanded to cells until someone asks for them
+	struct Macrocell
+	{
+		Pattern header; // name, rule and comments, width x height is the live cells' bounding box
+		QuadTree tree;
+		uint32_t root = 0;
+		int64_t minX = 0; // top left of the bounding box inside the root
+		int64_t minY = 0;
+		uint64_t generation = 0; // #G, the generation the file was saved at
+		bool hasPosition = false; // #P, where the root's top left was on the board it was saved from
+		int64_t positionX = 0;
+		int64_t positionY = 0;
+
+		// aliveRun(x, y, length) for every run of live cells, relative to the bounding box like Pattern's cells
+		template <typename AliveRun>
+		void forEachRun(AliveRun aliveRun) const
+		{
+			tree.forEachRun(root, -minX, -minY, aliveRun);
+		}
+	};
+
+	inline Macrocell readMacrocell(std::istream& in)
+	{
+		Macrocell file;
+		std::string line;
+		if (!std::getline(in, line) || line.compare(0, 4, "[M2]") != 0)
+			throw std::runtime_error("PatternIO: not a macrocell file, it should start with [M2]");
+
+		// file node numbers (from 1) to tree nodes, 0 is the empty node in both
+		std::vector<uint32_t> nodeOf = { 0 };
+		std::vector<int> levelOf = { 0 };
+		while (std::getline(in, line))
+		{
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			if (line.empty()) continue;
+
+			if (line[0] == '#')
+			{
+				if (line.compare(0, 3, "#R ") == 0)
+				{
+					std::string rule = RleReader::trim(line.substr(3));
+					file.header.rule = Rule::parse(rule.substr(0, rule.find(':')));
+					file.header.hasRule = true;
+				}
+				else if (line.compare(0, 3, "#G ") == 0)
+					file.generation = std::stoull(line.substr(3));
+				else if (line.compare(0, 3, "#N ") == 0)
+					file.header.name = RleReader::trim(line.substr(3));
+				else if (line.compare(0, 3, "#P ") == 0)
+				{
+					std::istringstream position(line.substr(3));
+					if (!(position >> file.positionX >> file.positionY))
+						throw std::runtime_error("PatternIO: bad macrocell position \"" + line + "\"");
+					file.hasPosition = true;
+				}
+				else
+					file.header.comments.push_back(line);
+				continue;
+			}
+
+			if (line[0] == '.' || line[0] == '*' || line[0] == '$')
+			{
+				uint64_t cells = 0;
+				int x = 0, y = 0;
+				for (char c : line)
+				{
+					if (c == '$')
+					{
+						x = 0;
+						y++;
+						continue;
+					}
+					if (x >= 8 || y >= 8 || (c != '.' && c != '*'))
+						throw std::runtime_error("PatternIO: bad macrocell leaf \"" + line + "\"");
+					if (c == '*')
+						cells |= 1ull << (y * 8 + x);
+					x++;
+				}
+				nodeOf.push_back(file.tree.makeLeaf(cells));
+				levelOf.push_back(QuadTree::leafLevel);
+				continue;
+			}
+
+			std::istringstream fields(line);
+			int level = 0;
+			uint64_t children[4];
+			if (!(fields >> level >> children[0] >> children[1] >> children[2] >> children[3]))
+				throw std::runtime_error("PatternIO: bad macrocell node \"" + line + "\"");
+			if (level <= QuadTree::leafLevel || level > QuadTree::maxLevel)
+				throw std::runtime_error("PatternIO: unsupported macrocell level in \"" + line + "\" (only two-state patterns are read)");
+
+			uint32_t ids[4];
+			for (int q = 0; q < 4; q++)
+			{
+				if (children[q] >= nodeOf.size() || (children[q] != 0 && levelOf[children[q]] != level - 1))
+					throw std::runtime_error("PatternIO: macrocell node \"" + line + "\" points at a missing or wrong sized node");
+				ids[q] = nodeOf[children[q]];
+			}
+			nodeOf.push_back(file.tree.makeNode(level, ids[0], ids[1], ids[2], ids[3]));
+			levelOf.push_back(level);
+		}
+
+		file.root = nodeOf.back(); // the last node is the whole pattern
+		int64_t maxX = -1, maxY = -1;
+		if (file.tree.boundingBox(file.root, file.minX, file.minY, maxX, maxY))
+		{
+			file.header.width = maxX - file.minX + 1;
+			file.header.height = maxY - file.minY + 1;
+		}
+		return file;
+	}
+
+	// post-order so every node is written after its children, a node already written is just referred to
+	// (x0, y0) is where the root's top left was, written as #P so loading the file puts the cells back there
+	// (the tree itself only knows where they are inside the root, its empty top and left would be trimmed)
+	inline void writeMacrocell(std::ostream& out, const QuadTree& tree, uint32_t root, const Rule& rule = Rule(),
+		uint64_t generation = 0, const std::string& name = "", const std::vector<std::string>& comments = {}, int64_t x0 = 0, int64_t y0 = 0)
+	{
+		out << "[M2] (GameOfLife)\n#R " << rule.toString() << '\n';
+		out << "#P " << x0 << ' ' << y0 << '\n';
+		if (generation > 0)
+			out << "#G " << generation << '\n';
+		if (!name.empty())
+			out << "#N " << name << '\n';
+		for (const std::string& comment : comments)
+			out << comment << '\n';
+
+		std::vector<uint64_t> lineOf(tree.nodes.size(), 0);
+		uint64_t lines = 0;
+		std::string leaf;
+		auto write = [&](auto& self, uint32_t id) -> uint64_t
+		{
+			if (id == 0 || lineOf[id] != 0) return lineOf[id];
+			const QuadTree::Node& n = tree.node(id);
+			if (n.level == QuadTree::leafLevel)
+			{
+				// rows up to the last live cell, rows after the last live one are left off
+				leaf.clear();
+				for (int y = 0; y < 8; y++)
+				{
+					if ((n.leaf >> (y * 8)) == 0) break;
+					uint32_t row = static_cast<uint32_t>(n.leaf >> (y * 8)) & 0xff;
+					for (int x = 0; row >> x; x++)
+						leaf += ((row >> x) & 1) ? '*' : '.';
+					leaf += '$';
+				}
+				out << leaf << '\n';
+			}
+			else
+			{
+				uint64_t children[4];
+				for (int q = 0; q < 4; q++)
+					children[q] = self(self, n.children[q]);
+				out << n.level << ' ' << children[0] << ' ' << children[1] << ' ' << children[2] << ' ' << children[3] << '\n';
+			}
+			return lineOf[id] = ++lines;
+		};
+		write(write, root);
+	}
+
+	inline Pattern readMacrocellCells(std::istream& in)
+	{
+		Macrocell file = readMacrocell(in);
+		Pattern pattern = file.header;
+		file.forEachRun([&](int64_t x, int64_t y, int64_t length)
+		{
+			for (int64_t k = 0; k < length; k++)
+				pattern.cells.emplace_back(x + k, y);
+		});
+		return pattern;
+	}
+
+	inline Pattern load(const std::string& path)
+	{
+		std::ifstream in(path, std::ios::binary);
+		if (!in)
+			throw std::runtime_error("PatternIO: can't open " + path);
+
+		if (hasExtension(path, ".cells") || hasExtension(path, ".txt"))
+			return readCells(in);
+		if (hasExtension(path, ".rle"))
+			return readRle(in);
+		if (hasExtension(path, ".mc"))
+			return readMacrocellCells(in);
+		throw std::invalid_argument("PatternIO: unknown pattern format " + path);
+	}
+
+	// comments are written as they are into .rle and .mc files, plaintext only has room for the name
+	template <typename IsAlive>
+	void save(const std::string& path, int64_t x0, int64_t y0, int64_t width, int64_t height, IsAlive isAlive, const std::string& name = "", const Rule& rule = Rule(),
+		const std::vector<std::string>& comments = {})
+	{
+		std::ofstream out(path, std::ios::binary);
+		if (!out)
+			throw std::runtime_error("PatternIO: can't write " + path);
+
+		if (hasExtension(path, ".cells") || hasExtension(path, ".txt"))
+			writeCells(out, x0, y0, width, height, isAlive, name);
+		else if (hasExtension(path, ".rle"))
+			writeRle(out, x0, y0, width, height, isAlive, name, rule, comments);
+		else if (hasExtension(path, ".mc"))
+		{
+			QuadTree tree;
+			uint32_t root = tree.build(QuadTree::levelFor(std::max(width, height)), x0, y0, width, height, isAlive);
+			writeMacrocell(out, tree, root, rule, 0, name, comments, x0, y0);
+		}
+		else
+			throw std::invalid_argument("PatternIO: unknown pattern format " + path);
+
+		if (!out)
+			throw std::runtime_error("PatternIO: failed writing " + path);
+	}
+}
@@ -0,0 +1,478 @@
+#pragma once
+#include "PatternIO.hpp"
+#include "QuadTree.hpp"
+#include "Rule.hpp"
+#include "SoftwareRenderer.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// a directory of pattern files (.rle, .mc, .cells, searched recursively) for picking patterns from
+// what the browser shows of each file (name, bounding box, rule, population and a small thumbnail) is kept
+// in an index file in the directory, so a library of tens of thousands of files opens by reading that one
+// file and looking at the others' sizes and times instead of parsing every pattern
+// files that are new or changed since the index was written are indexed by worker threads in the
+// background, the ones on screen (focus) first, and the index is written back when the library is finished
+// the full pattern is only read when it's placed
+// a thumbnail is a bit per pixel, set if any cell the pixel covers is alive, worked out from the runs of
+// live cells (or the macrocell tree, only down to nodes that fit in a pixel) without laying the pattern out
+// index layout: IndexHeader then per file an IndexRecord, its path and name, and thumbnail.height words
+
+struct PatternLibrary
+{
+	static constexpr const char* indexName = ".gameoflife-index";
+	static constexpr uint32_t indexVersion = 1;
+	static constexpr int thumbnailSize = 64; // pixels on the long side, a row fits one word
+
+	struct IndexHeader
+	{
+		char magic[4]; // "GOLP"
+		uint32_t version;
+		uint64_t entries;
+	};
+
+	struct IndexRecord
+	{
+		uint64_t fileSize;
+		int64_t modified;
+		int64_t width;
+		int64_t height;
+		uint64_t population;
+		uint16_t birth; // Rule masks
+		uint16_t survival;
+		uint8_t hasRule;
+		uint8_t failed; // couldn't be read, left alone until the file changes
+		uint16_t thumbnailWidth;
+		uint16_t thumbnailHeight;
+		uint16_t pathBytes;
+		uint16_t nameBytes;
+		uint16_t reserved;
+	};
+
+	enum State : int
+	{
+		Pending,
+		Working,
+		Ready,
+		Failed
+	};
+
+	struct Entry
+	{
+		std::string path; // relative to the library directory
+		uint64_t fileSize = 0;
+		int64_t modified = 0;
+		std::atomic<int> state{ Pending }; // the rest is only read once this is Ready or Failed
+
+		std::string name; // the file's own name for the pattern, the file name if it has none
+		int64_t width = 0; // bounding box of the live cells (the header's size for .rle)
+		int64_t height = 0;
+		uint64_t population = 0;
+		bool hasRule = false;
+		Rule rule;
+		BitFrame thumbnail;
+	};
+
+	// thrown out of a worker that is asked to stop in the middle of a big file
+	struct Cancelled
+	{
+	};
+
+	std::filesystem::path directory;
+	std::deque<Entry> entries; // sorted by path, never added to or removed from once the library is open
+
+	std::vector<std::thread> workers;
+	std::atomic<bool> stopping{ false };
+	std::atomic<size_t> cursor{ 0 }; // entries before this have been claimed or looked at
+	std::atomic<size_t> focusBegin{ 0 }; // what's on screen, claimed before anything else
+	std::atomic<size_t> focusEnd{ 0 };
+	std::atomic<size_t> indexed{ 0 }; // Ready or Failed, the cached ones included
+	size_t fromIndex = 0; // came out of the index file unchanged
+	bool cachedFilesGone = false; // the index lists files that aren't there anymore
+
+	// threads = 0 uses one per hardware thread, less one for the window
+	PatternLibrary(const std::string& path, int threads = 0) : directory(path)
+	{
+		if (!std::filesystem::is_directory(directory))
+			throw std::runtime_error("PatternLibrary: " + path + " is not a directory");
+
+		std::unordered_map<std::string, size_t> cached;
+		std::deque<Entry> previous;
+		readIndex(previous, cached);
+		scan(previous, cached);
+
+		if (threads <= 0)
+			threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+		if (indexed < entries.size())
+		{
+			for (int t = 0; t < threads; t++)
+				workers.emplace_back(&PatternLibrary::workerLoop, this);
+		}
+	}
+
+	~PatternLibrary()
+	{
+		try
+		{
+			finish();
+		}
+		catch (const std::exception&)
+		{
+			// nowhere to report it from a destructor, call finish() first to find out
+		}
+	}
+
+	PatternLibrary(const PatternLibrary&) = delete;
+	PatternLibrary& operator=(const PatternLibrary&) = delete;
+
+	static bool isPatternFile(const std::filesystem::path& path)
+	{
+		std::string name = path.filename().string();
+		return PatternIO::hasExtension(name, ".rle") || PatternIO::hasExtension(name, ".mc") || PatternIO::hasExtension(name, ".cells");
+	}
+
+	size_t size() const
+	{
+		return entries.size();
+	}
+
+	bool busy() const
+	{
+		return indexed < entries.size();
+	}
+
+	// entries first .. first + count - 1 are on screen, their thumbnails are made next
+	void focus(size_t first, size_t count)
+	{
+		focusBegin = std::min(first, entries.size());
+		focusEnd = std::min(first + count, entries.size());
+	}
+
+	// reads the whole pattern, only call it for an entry that is Ready
+	PatternIO::Pattern load(size_t index) const
+	{
+		PatternIO::Pattern pattern = PatternIO::load((directory / entries[index].path).string());
+		if (pattern.name.empty())
+			pattern.name = entries[index].name;
+		return pattern;
+	}
+
+	// stops the workers (what's half done is indexed again next time) and writes the index back if
+	// anything new was indexed, throws if that fails
+	void finish()
+	{
+		if (stopping.exchange(true)) return;
+		for (std::thread& worker : workers)
+			worker.join();
+		workers.clear();
+
+		if (indexed > fromIndex || cachedFilesGone)
+			writeIndex();
+	}
+
+	void readIndex(std::deque<Entry>& previous, std::unordered_map<std::string, size_t>& cached)
+	{
+		std::ifstream in(directory / indexName, std::ios::binary);
+		if (!in) return;
+
+		// a damaged or outdated index is just ignored, everything gets indexed again
+		IndexHeader header;
+		if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::string(header.magic, 4) != "GOLP" || header.version != indexVersion)
+			return;
+		for (uint64_t n = 0; n < header.entries; n++)
+		{
+			IndexRecord record;
+			if (!in.read(reinterpret_cast<char*>(&record), sizeof(record)) || record.thumbnailWidth > thumbnailSize || record.thumbnailHeight > thumbnailSize)
+				break;
+			previous.emplace_back();
+			Entry& entry = previous.back();
+			entry.path.resize(record.pathBytes);
+			entry.name.resize(record.nameBytes);
+			in.read(&entry.path[0], record.pathBytes);
+			in.read(&entry.name[0], record.nameBytes);
+			entry.fileSize = record.fileSize;
+			entry.modified = record.modified;
+			entry.width = record.width;
+			entry.height = record.height;
+			entry.population = record.population;
+			entry.hasRule = record.hasRule != 0;
+			entry.rule.birth = record.birth;
+			entry.rule.survival = record.survival;
+			entry.state = record.failed ? Failed : Ready;
+			entry.thumbnail.resize(record.thumbnailWidth, record.thumbnailHeight);
+			in.read(reinterpret_cast<char*>(entry.thumbnail.words.data()), entry.thumbnail.words.size() * sizeof(uint64_t));
+			if (!in)
+			{
+				previous.pop_back();
+				break;
+			}
+			cached[entry.path] = previous.size() - 1;
+		}
+	}
+
+	// every pattern file under the directory, the ones the index already knows as they were (same size
+	// and time) come straight from it
+	void scan(std::deque<Entry>& previous, std::unordered_map<std::string, size_t>& cached)
+	{
+		std::vector<std::string> paths;
+		std::error_code error;
+		for (std::filesystem::recursive_directory_iterator it(directory, std::filesystem::directory_options::skip_permission_denied, error), end;
+			!error && it != end; it.increment(error))
+		{
+			if (it->is_regular_file(error) && isPatternFile(it->path()))
+				paths.push_back(std::filesystem::relative(it->path(), directory, error).generic_string());
+		}
+		std::sort(paths.begin(), paths.end());
+
+		size_t stillThere = 0;
+		for (const std::string& path : paths)
+		{
+			entries.emplace_back();
+			Entry& entry = entries.back();
+			entry.path = path;
+			std::filesystem::path full = directory / path;
+			entry.fileSize = static_cast<uint64_t>(std::filesystem::file_size(full, error));
+			entry.modified = static_cast<int64_t>(std::filesystem::last_write_time(full, error).time_since_epoch().count());
+
+			auto known = cached.find(path);
+			if (known == cached.end()) continue;
+			stillThere++;
+			Entry& old = previous[known->second];
+			if (old.fileSize != entry.fileSize || old.modified != entry.modified) continue;
+
+			entry.name = std::move(old.name);
+			entry.width = old.width;
+			entry.height = old.height;
+			entry.population = old.population;
+			entry.hasRule = old.hasRule;
+			entry.rule = old.rule;
+			entry.thumbnail = std::move(old.thumbnail);
+			entry.state = old.state.load();
+			indexed++;
+		}
+		fromIndex = indexed;
+		cachedFilesGone = stillThere < cached.size();
+	}
+
+	// written next to the old one and moved over it, a crash never leaves a half written index behind
+	void writeIndex()
+	{
+		std::filesystem::path path = directory / indexName;
+		std::filesystem::path temporary = path;
+		temporary += ".partial";
+		{
+			std::ofstream out(temporary, std::ios::binary);
+			if (!out)
+				throw std::runtime_error("PatternLibrary: can't write " + temporary.string());
+
+			IndexHeader header = { { 'G', 'O', 'L', 'P' }, indexVersion, 0 };
+			for (const Entry& entry : entries)
+				if (entry.state == Ready || entry.state == Failed)
+					header.entries++;
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+			for (const Entry& entry : entries)
+			{
+				int state = entry.state;
+				if (state != Ready && state != Failed) continue;
+				std::string name = entry.name.substr(0, UINT16_MAX);
+				IndexRecord record = {};
+				record.fileSize = entry.fileSize;
+				record.modified = entry.modified;
+				record.width = entry.width;
+				record.height = entry.height;
+				record.population = entry.population;
+				record.birth = entry.rule.birth;
+				record.survival = entry.rule.survival;
+				record.hasRule = entry.hasRule;
+				record.failed = state == Failed;
+				record.thumbnailWidth = static_cast<uint16_t>(entry.thumbnail.width);
+				record.thumbnailHeight = static_cast<uint16_t>(entry.thumbnail.height);
+				record.pathBytes = static_cast<uint16_t>(std::min<size_t>(entry.path.size(), UINT16_MAX));
+				record.nameBytes = static_cast<uint16_t>(name.size());
+				out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+				out.write(entry.path.data(), record.pathBytes);
+				out.write(name.data(), record.nameBytes);
+				out.write(reinterpret_cast<const char*>(entry.thumbnail.words.data()), entry.thumbnail.words.size() * sizeof(uint64_t));
+			}
+			if (!out.flush())
+				throw std::runtime_error("PatternLibrary: failed writing " + temporary.string());
+		}
+		std::filesystem::rename(temporary, path);
+	}
+
+	bool claim(size_t index)
+	{
+		int expected = Pending;
+		return entries[index].state.compare_exchange_strong(expected, Working);
+	}
+
+	// what's on screen first, then the rest in order
+	bool claimNext(size_t& index)
+	{
+		for (size_t n = focusBegin; n < focusEnd && n < entries.size(); n++)
+		{
+			if (claim(n))
+			{
+				index = n;
+				return true;
+			}
+		}
+		while ((index = cursor.fetch_add(1)) < entries.size())
+		{
+			if (claim(index))
+				return true;
+		}
+		return false;
+	}
+
+	void workerLoop()
+	{
+		size_t index;
+		while (!stopping && claimNext(index))
+		{
+			Entry& entry = entries[index];
+			int state = Failed;
+			try
+			{
+				indexFile(entry);
+				state = Ready;
+			}
+			catch (const Cancelled&)
+			{
+				entry.state = Pending;
+				return;
+			}
+			catch (const std::exception&)
+			{
+				// shown as unreadable, the file gets another try once it changes
+				entry.name = std::filesystem::path(entry.path).stem().string();
+			}
+			entry.state.store(state, std::memory_order_release);
+			indexed++;
+		}
+	}
+
+	void indexFile(Entry& entry)
+	{
+		std::string full = (directory / entry.path).string();
+		std::ifstream in(full, std::ios::binary);
+		if (!in)
+			throw std::runtime_error("PatternLibrary: can't open " + full);
+
+		PatternIO::Pattern header;
+		Thumbnail thumbnail;
+		if (PatternIO::hasExtension(full, ".rle"))
+		{
+			PatternIO::RleReader reader(in);
+			header = reader.header;
+			thumbnail.start(header.width, header.height);
+			uint64_t population = 0;
+			reader.readCells([&](int64_t x, int64_t y, int64_t length)
+			{
+				if (stopping.load(std::memory_order_relaxed))
+					throw Cancelled();
+				population += static_cast<uint64_t>(length);
+				thumbnail.run(x, y, length);
+			});
+			entry.population = population;
+		}
+		else if (PatternIO::hasExtension(full, ".mc"))
+		{
+			PatternIO::Macrocell file = PatternIO::readMacrocell(in);
+			header = file.header;
+			thumbnail.start(header.width, header.height);
+			thumbnail.tree(file.tree, file.root, -file.minX, -file.minY, stopping);
+			entry.population = file.tree.population(file.root);
+		}
+		else
+		{
+			header = PatternIO::readCells(in);
+			thumbnail.start(header.width, header.height);
+			for (const auto& cell : header.cells)
+				thumbnail.run(cell.first, cell.second, 1);
+			entry.population = header.cells.size();
+		}
+
+		entry.name = !header.name.empty() ? header.name : std::filesystem::path(entry.path).stem().string();
+		entry.width = header.width;
+		entry.height = header.height;
+		entry.hasRule = header.hasRule;
+		entry.rule = header.rule;
+		entry.thumbnail = std::move(thumbnail.frame);
+	}
+
+	// the pattern shrunk to at most thumbnailSize pixels on its long side, scale x scale cells a pixel
+	struct Thumbnail
+	{
+		BitFrame frame;
+		int64_t scale = 1;
+		int64_t width = 0;
+		int64_t height = 0;
+
+		void start(int64_t patternWidth, int64_t patternHeight)
+		{
+			width = patternWidth;
+			height = patternHeight;
+			int64_t side = std::max<int64_t>(1, std::max(width, height));
+			scale = (side + thumbnailSize - 1) / thumbnailSize;
+			frame.resize(static_cast<int>((std::max<int64_t>(width, 1) + scale - 1) / scale), static_cast<int>((std::max<int64_t>(height, 1) + scale - 1) / scale));
+		}
+
+		// live cells x .. x + length - 1 of row y, clipped to the pattern
+		void run(int64_t x, int64_t y, int64_t length)
+		{
+			if (y < 0 || y >= height || length <= 0) return;
+			int64_t first = std::max<int64_t>(x, 0);
+			int64_t last = std::min(x + length, width) - 1;
+			if (first > last) return;
+			int64_t left = first / scale, right = last / scale;
+			uint64_t upTo = right == 63 ? ~0ull : (1ull << (right + 1)) - 1;
+			frame.row(static_cast<int>(y / scale))[0] |= upTo & ~((1ull << left) - 1);
+		}
+
+		// node id with its top left at x0, y0, going down only until a node falls inside one pixel
+		void tree(const QuadTree& quadTree, uint32_t id, int64_t x0, int64_t y0, const std::atomic<bool>& stopping)
+		{
+			if (id == 0) return;
+			if (stopping.load(std::memory_order_relaxed))
+				throw Cancelled();
+
+			const QuadTree::Node& n = quadTree.node(id);
+			int64_t size = int64_t(1) << n.level;
+			if (x0 >= width || y0 >= height || x0 + size <= 0 || y0 + size <= 0)
+				return;
+
+			// everything live in it lights the same pixel
+			int64_t first = std::max<int64_t>(x0, 0), top = std::max<int64_t>(y0, 0);
+			int64_t last = std::min(x0 + size, width) - 1, bottom = std::min(y0 + size, height) - 1;
+			if (first / scale == last / scale && top / scale == bottom / scale)
+			{
+				frame.row(static_cast<int>(top / scale))[0] |= 1ull << (first / scale);
+				return;
+			}
+
+			if (n.level == QuadTree::leafLevel)
+			{
+				for (int bit = 0; bit < 64; bit++)
+					if ((n.leaf >> bit) & 1)
+						run(x0 + (bit & 7), y0 + (bit >> 3), 1);
+				return;
+			}
+
+			int64_t half = size / 2;
+			tree(quadTree, n.children[0], x0, y0, stopping);
+			tree(quadTree, n.children[1], x0 + half, y0, stopping);
+			tree(quadTree, n.children[2], x0, y0 + half, stopping);
+			tree(quadTree, n.children[3], x0 + half, y0 + half, stopping);
+		}
+	};
+};
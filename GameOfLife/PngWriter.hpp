@@ -0,0 +1,227 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// minimal png encoder for 8 bit rgb images, no zlib needed
+// deflate uses the fixed huffman codes and only looks for two kinds of matches: the pixel to the left
+// and the same spot in the row above, which is where all the repetition in a board picture is
+// (runs of dead tiles, and every cell drawn as several identical rows)
+
+namespace Png
+{
+	inline uint32_t crc32(const uint8_t* data, size_t length, uint32_t crc = 0)
+	{
+		static const std::vector<uint32_t> table = []
+		{
+			std::vector<uint32_t> entries(256);
+			for (uint32_t n = 0; n < 256; n++)
+			{
+				uint32_t c = n;
+				for (int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				entries[n] = c;
+			}
+			return entries;
+		}();
+
+		crc = ~crc;
+		for (size_t n = 0; n < length; n++)
+			crc = table[(crc ^ data[n]) & 0xff] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	inline uint32_t adler32(const uint8_t* data, size_t length)
+	{
+		uint32_t a = 1, b = 0;
+		while (length > 0)
+		{
+			size_t block = length < 5552 ? length : 5552; // largest run that can't overflow before the modulo
+			for (size_t n = 0; n < block; n++)
+			{
+				a += data[n];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+			data += block;
+			length -= block;
+		}
+		return (b << 16) | a;
+	}
+
+	// deflate bit writer, bits go out least significant first, huffman codes most significant first
+	struct BitWriter
+	{
+		std::vector<uint8_t>& out;
+		uint32_t buffer = 0;
+		int count = 0;
+
+		BitWriter(std::vector<uint8_t>& output) : out(output) {}
+
+		void bits(uint32_t value, int length)
+		{
+			buffer |= value << count;
+			count += length;
+			while (count >= 8)
+			{
+				out.push_back(static_cast<uint8_t>(buffer));
+				buffer >>= 8;
+				count -= 8;
+			}
+		}
+
+		void code(uint32_t value, int length)
+		{
+			uint32_t reversed = 0;
+			for (int n = 0; n < length; n++)
+				reversed |= ((value >> n) & 1) << (length - 1 - n);
+			bits(reversed, length);
+		}
+
+		void flush()
+		{
+			if (count > 0)
+				out.push_back(static_cast<uint8_t>(buffer));
+			buffer = 0;
+			count = 0;
+		}
+	};
+
+	inline void literal(BitWriter& writer, uint32_t symbol)
+	{
+		if (symbol < 144) writer.code(0x30 + symbol, 8);
+		else if (symbol < 256) writer.code(0x190 + symbol - 144, 9);
+		else if (symbol < 280) writer.code(symbol - 256, 7);
+		else writer.code(0xc0 + symbol - 280, 8);
+	}
+
+	inline void match(BitWriter& writer, uint32_t length, uint32_t distance)
+	{
+		static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		static const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		int l = 28;
+		while (lengthBase[l] > length) l--;
+		literal(writer, 257 + l);
+		writer.bits(length - lengthBase[l], lengthExtra[l]);
+
+		int d = 29;
+		while (distanceBase[d] > distance) d--;
+		writer.code(d, 5);
+		writer.bits(distance - distanceBase[d], distanceExtra[d]);
+	}
+
+	// zlib stream of data, rowBytes is the distance to the row above (0 to not look there)
+	inline void deflate(const std::vector<uint8_t>& data, size_t rowBytes, size_t pixelBytes, std::vector<uint8_t>& out)
+	{
+		static const size_t maxDistance = 32768;
+		static const size_t maxLength = 258;
+
+		out.push_back(0x78); // deflate, 32k window
+		out.push_back(0x01);
+
+		BitWriter writer(out);
+		writer.bits(1, 1); // last block
+		writer.bits(1, 2); // fixed huffman codes
+
+		size_t candidates[2] = { pixelBytes, rowBytes <= maxDistance ? rowBytes : 0 };
+		size_t n = 0;
+		while (n < data.size())
+		{
+			size_t bestLength = 0, bestDistance = 0;
+			for (size_t distance : candidates)
+			{
+				if (distance == 0 || distance > n) continue;
+				size_t length = 0;
+				size_t limit = data.size() - n < maxLength ? data.size() - n : maxLength;
+				while (length < limit && data[n + length] == data[n + length - distance])
+					length++;
+				if (length > bestLength)
+				{
+					bestLength = length;
+					bestDistance = distance;
+				}
+			}
+
+			if (bestLength >= 3)
+			{
+				match(writer, static_cast<uint32_t>(bestLength), static_cast<uint32_t>(bestDistance));
+				n += bestLength;
+			}
+			else
+			{
+				literal(writer, data[n]);
+				n++;
+			}
+		}
+		literal(writer, 256); // end of block
+		writer.flush();
+
+		uint32_t adler = adler32(data.data(), data.size());
+		for (int shift = 24; shift >= 0; shift -= 8)
+			out.push_back(static_cast<uint8_t>(adler >> shift));
+	}
+
+	inline void chunk(std::vector<uint8_t>& out, const char type[4], const std::vector<uint8_t>& data)
+	{
+		uint32_t length = static_cast<uint32_t>(data.size());
+		for (int shift = 24; shift >= 0; shift -= 8)
+			out.push_back(static_cast<uint8_t>(length >> shift));
+
+		size_t start = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data.begin(), data.end());
+
+		uint32_t crc = crc32(out.data() + start, out.size() - start);
+		for (int shift = 24; shift >= 0; shift -= 8)
+			out.push_back(static_cast<uint8_t>(crc >> shift));
+	}
+
+	// whole png file for a width x height rgb image, rows top to bottom with no padding
+	inline std::vector<uint8_t> encode(int width, int height, const uint8_t* rgb)
+	{
+		size_t rowBytes = static_cast<size_t>(width) * 3;
+
+		// every scanline gets filter type 0, the matches against the row above do what the up filter would
+		std::vector<uint8_t> scanlines;
+		scanlines.reserve((rowBytes + 1) * height);
+		for (int y = 0; y < height; y++)
+		{
+			scanlines.push_back(0);
+			scanlines.insert(scanlines.end(), rgb + y * rowBytes, rgb + (y + 1) * rowBytes);
+		}
+
+		std::vector<uint8_t> header;
+		for (uint32_t value : { static_cast<uint32_t>(width), static_cast<uint32_t>(height) })
+			for (int shift = 24; shift >= 0; shift -= 8)
+				header.push_back(static_cast<uint8_t>(value >> shift));
+		header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8 bit rgb, deflate, no filtering extras, no interlace
+
+		std::vector<uint8_t> compressed;
+		deflate(scanlines, rowBytes + 1, 3, compressed);
+
+		std::vector<uint8_t> file = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+		chunk(file, "IHDR", header);
+		chunk(file, "IDAT", compressed);
+		chunk(file, "IEND", {});
+		return file;
+	}
+
+	inline void save(const std::string& path, const std::vector<uint8_t>& file)
+	{
+		std::ofstream out(path, std::ios::binary);
+		if (!out || !out.write(reinterpret_cast<const char*>(file.data()), file.size()))
+			throw std::runtime_error("Png: can't write " + path);
+	}
+
+	inline void save(const std::string& path, int width, int height, const uint8_t* rgb)
+	{
+		save(path, encode(width, height, rgb));
+	}
+}
@@ -0,0 +1,247 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+// hash-consed quadtree of cells, the structure behind the macrocell (.mc) format
+// a node at level k covers 2^k x 2^k cells through four children at level k - 1, level 3 nodes are leaves
+// holding their 8 x 8 cells as the bits of a word (bit y * 8 + x)
+// every distinct node is stored once, so repeated parts of a pattern share one node no matter how many
+// times they appear, and node 0 stands for an empty square of any level
+// huge patterns (far too big to ever lay out flat) stay small as long as they are regular
+
+struct QuadTree
+{
+	static constexpr int leafLevel = 3;
+	static constexpr int maxLevel = 62; // offsets inside the root still fit an int64_t
+
+	struct Node
+	{
+		int level = 0;
+		uint32_t children[4] = {}; // nw, ne, sw, se
+		uint64_t leaf = 0; // cells of a level 3 node
+		uint64_t population = 0; // sticks at the maximum for patterns with more cells than that
+	};
+
+	struct Key
+	{
+		int level;
+		uint32_t children[4];
+		uint64_t leaf;
+
+		bool operator==(const Key& other) const
+		{
+			return level == other.level && leaf == other.leaf && children[0] == other.children[0] && children[1] == other.children[1]
+				&& children[2] == other.children[2] && children[3] == other.children[3];
+		}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const
+		{
+			uint64_t h = key.leaf * 0x9e3779b97f4a7c15ull + static_cast<uint64_t>(key.level);
+			for (uint32_t child : key.children)
+				h = (h ^ child) * 0x100000001b3ull;
+			return static_cast<size_t>(h ^ (h >> 29));
+		}
+	};
+
+	std::vector<Node> nodes;
+	std::unordered_map<Key, uint32_t, KeyHash> index;
+
+	QuadTree()
+	{
+		nodes.emplace_back(); // the empty node
+	}
+
+	const Node& node(uint32_t id) const
+	{
+		return nodes[id];
+	}
+
+	uint64_t population(uint32_t id) const
+	{
+		return nodes[id].population;
+	}
+
+	uint32_t intern(const Key& key, uint64_t population)
+	{
+		auto found = index.find(key);
+		if (found != index.end())
+			return found->second;
+
+		if (nodes.size() >= UINT32_MAX)
+			throw std::length_error("QuadTree: too many nodes");
+		Node created;
+		created.level = key.level;
+		for (int q = 0; q < 4; q++)
+			created.children[q] = key.children[q];
+		created.leaf = key.leaf;
+		created.population = population;
+
+		uint32_t id = static_cast<uint32_t>(nodes.size());
+		nodes.push_back(created);
+		index.emplace(key, id);
+		return id;
+	}
+
+	uint32_t makeLeaf(uint64_t cells)
+	{
+		if (cells == 0) return 0;
+		uint64_t count = 0;
+		for (uint64_t bits = cells; bits; bits &= bits - 1)
+			count++;
+		return intern(Key{ leafLevel, { 0, 0, 0, 0 }, cells }, count);
+	}
+
+	// children must be level - 1 nodes (or 0)
+	uint32_t makeNode(int level, uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se)
+	{
+		if (level <= leafLevel || level > maxLevel)
+			throw std::invalid_argument("QuadTree: node level out of range");
+		if ((nw | ne | sw | se) == 0) return 0;
+
+		uint64_t total = 0;
+		for (uint32_t child : { nw, ne, sw, se })
+		{
+			uint64_t count = nodes[child].population;
+			total = total + count < total ? UINT64_MAX : total + count;
+		}
+		return intern(Key{ level, { nw, ne, sw, se }, 0 }, total);
+	}
+
+	// smallest level whose square is at least size cells wide
+	static int levelFor(int64_t size)
+	{
+		int level = leafLevel;
+		while (level < maxLevel && (int64_t(1) << level) < size)
+			level++;
+		return level;
+	}
+
+	// tree for the width x height region at (x0, y0) of anything that answers isAlive(x, y), placed at the
+	// root's top left, every cell of the region is asked once
+	template <typename IsAlive>
+	uint32_t build(int level, int64_t x0, int64_t y0, int64_t width, int64_t height, IsAlive isAlive)
+	{
+		return buildPart(level, 0, 0, x0, y0, width, height, isAlive);
+	}
+
+	template <typename IsAlive>
+	uint32_t buildPart(int level, int64_t x, int64_t y, int64_t x0, int64_t y0, int64_t width, int64_t height, IsAlive& isAlive)
+	{
+		if (x >= width || y >= height) return 0;
+		if (level == leafLevel)
+		{
+			uint64_t cells = 0;
+			for (int dy = 0; dy < 8 && y + dy < height; dy++)
+				for (int dx = 0; dx < 8 && x + dx < width; dx++)
+					if (isAlive(x0 + x + dx, y0 + y + dy))
+						cells |= 1ull << (dy * 8 + dx);
+			return makeLeaf(cells);
+		}
+
+		int64_t half = int64_t(1) << (level - 1);
+		uint32_t nw = buildPart(level - 1, x, y, x0, y0, width, height, isAlive);
+		uint32_t ne = buildPart(level - 1, x + half, y, x0, y0, width, height, isAlive);
+		uint32_t sw = buildPart(level - 1, x, y + half, x0, y0, width, height, isAlive);
+		uint32_t se = buildPart(level - 1, x + half, y + half, x0, y0, width, height, isAlive);
+		return makeNode(level, nw, ne, sw, se);
+	}
+
+	// calls aliveRun(x, y, length) for every horizontal run of live cells inside a leaf, x and y relative
+	// to the top left of node id placed at (x0, y0), empty parts are skipped without being visited
+	template <typename AliveRun>
+	void forEachRun(uint32_t id, int64_t x0, int64_t y0, AliveRun& aliveRun) const
+	{
+		if (id == 0) return;
+		const Node& n = nodes[id];
+		if (n.level == leafLevel)
+		{
+			for (int y = 0; y < 8; y++)
+			{
+				uint32_t row = static_cast<uint32_t>(n.leaf >> (y * 8)) & 0xff;
+				int x = 0;
+				while (row)
+				{
+					while (!(row & 1))
+					{
+						row >>= 1;
+						x++;
+					}
+					int length = 0;
+					while (row & 1)
+					{
+						row >>= 1;
+						length++;
+					}
+					aliveRun(x0 + x, y0 + y, static_cast<int64_t>(length));
+					x += length;
+				}
+			}
+			return;
+		}
+
+		int64_t half = int64_t(1) << (n.level - 1);
+		forEachRun(n.children[0], x0, y0, aliveRun);
+		forEachRun(n.children[1], x0 + half, y0, aliveRun);
+		forEachRun(n.children[2], x0, y0 + half, aliveRun);
+		forEachRun(n.children[3], x0 + half, y0 + half, aliveRun);
+	}
+
+	// bounding box of the live cells relative to the node's top left, false for an empty node
+	// boxes are worked out once per distinct node, so this is cheap even for patterns that are huge flat
+	bool boundingBox(uint32_t id, int64_t& minX, int64_t& minY, int64_t& maxX, int64_t& maxY) const
+	{
+		if (id == 0) return false;
+		std::vector<Box> boxes(nodes.size());
+		std::vector<char> known(nodes.size(), 0);
+		Box box = boxOf(id, boxes, known);
+		minX = box.minX;
+		minY = box.minY;
+		maxX = box.maxX;
+		maxY = box.maxY;
+		return true;
+	}
+
+	struct Box
+	{
+		int64_t minX, minY, maxX, maxY;
+	};
+
+	Box boxOf(uint32_t id, std::vector<Box>& boxes, std::vector<char>& known) const
+	{
+		if (known[id]) return boxes[id];
+
+		const Node& n = nodes[id];
+		Box box = { INT64_MAX, INT64_MAX, INT64_MIN, INT64_MIN };
+		if (n.level == leafLevel)
+		{
+			for (int bit = 0; bit < 64; bit++)
+			{
+				if (!((n.leaf >> bit) & 1)) continue;
+				int64_t x = bit & 7, y = bit >> 3;
+				box = { std::min(box.minX, x), std::min(box.minY, y), std::max(box.maxX, x), std::max(box.maxY, y) };
+			}
+		}
+		else
+		{
+			int64_t half = int64_t(1) << (n.level - 1);
+			for (int q = 0; q < 4; q++)
+			{
+				if (n.children[q] == 0) continue;
+				Box child = boxOf(n.children[q], boxes, known);
+				int64_t dx = (q & 1) ? half : 0;
+				int64_t dy = (q & 2) ? half : 0;
+				box = { std::min(box.minX, child.minX + dx), std::min(box.minY, child.minY + dy),
+					std::max(box.maxX, child.maxX + dx), std::max(box.maxY, child.maxY + dy) };
+			}
+		}
+		boxes[id] = box;
+		known[id] = 1;
+		return box;
+	}
+};
@@ -1,97 +1,578 @@
 #pragma once
 #include <SFML/Graphics.hpp> // be careful, double inclusion leads to bugs without error messages :D
 #include "Constants.hpp"
-#include "Grid.hpp"
+#include "Simulation.hpp"
+#include "CellAge.hpp"
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+enum class RenderMode
+{
+    Vertices, // two triangles per tile, keeps the look of the original renderer
+    Texture // one pixel per tile in a scaled texture, for boards with millions of tiles
+};
+
+// boards with more tiles than this start out in texture mode
+const size_t textureModeThreshold = 1000000;
 
 struct Renderer
 {
     sf::RenderWindow& window;
-    Grid& grid;
+
+    // the snapshot being drawn and what was drawn last frame, when frames skip
+    // snapshots the dirty list is rebuilt by diffing against drawnAlive
+    const GridSnapshot* snapshot = nullptr;
+    uint64_t drawnSequence = 0;
+    std::vector<uint8_t> drawnAlive;
+    std::vector<size_t> dirty;
+
+    RenderMode mode;
+    bool needsRebuild = true; // set when switching modes, the new mode starts from a full build
+
+    // a frame is only drawn when something on screen can have changed: a new snapshot, or the view
+    // (camera, window size, modes) being invalidated
+    uint64_t presentedSequence = 0;
+    bool viewDirty = true;
+
+    // tiles colors or the cell-age heatmap, the snapshot's dirty list has the tiles that got older too, the
+    // heatmap recolors those and keeps what it drew (drawnColors) to diff against after a skipped snapshot
+    // drawnWithAges is whether those colors came from real ages or the fallback before the first aged snapshot
+    ColorMode colorMode = ColorMode::Tiles;
+    std::vector<sf::Uint32> drawnColors;
+    bool drawnWithAges = false;
+
+    // camera, zoom is world units per screen pixel (1 = the original unzoomed layout)
+    sf::View camera;
+    float zoom = 1.f;
+    static constexpr float minZoom = 1.f / 16;
+    static constexpr float maxZoom = 256.f;
+
+    // falls back to drawing the cpu copy directly when the gpu has no vertex buffer support
+    bool useVertexBuffer = sf::VertexBuffer::isAvailable();
+    sf::VertexBuffer tileBuffer{ sf::Triangles, sf::VertexBuffer::Dynamic };
+    std::vector<sf::Vertex> tileVertices;
+
+    // texture mode, the board is split into pieces no bigger than the max texture size
+    struct TexturePiece
+    {
+        unsigned int x0, y0; // first tile covered by this piece
+        unsigned int width, height;
+        std::vector<sf::Uint8> pixels; // rgba, one pixel per tile
+        unsigned int dirtyBegin, dirtyEnd; // rows touched since the last upload
+        sf::Texture texture;
+        sf::Sprite sprite;
+    };
+    std::vector<TexturePiece> texturePieces;
+    unsigned int pieceSize = 0;
+
+    // zoomed-out level of detail, one pixel per density block for the visible part of the board only
+    sf::Texture densityTexture;
+    sf::Sprite densitySprite;
+    std::vector<sf::Uint8> densityPixels;
+
+    // cached grid-line overlay and the window size / zoom it was drawn for
+    static constexpr float minGridLinePixels = 4.f;
+    sf::RenderTexture overlayTexture;
+    sf::Sprite overlaySprite;
+    bool overlayValid = false;
+    sf::Vector2u overlaySize;
+    sf::Vector2f overlayViewSize;
 
     // Render Window is non-copyable so pass it by reference
     // and use an initialization list before the constructor executes
-    Renderer(sf::RenderWindow& win, Grid& grid) : window(win), grid(grid)
+    Renderer(sf::RenderWindow& win, size_t totalTiles) : window(win), camera(win.getDefaultView())
+    {
+        mode = totalTiles > textureModeThreshold ? RenderMode::Texture : RenderMode::Vertices;
+    }
+
+    void invalidate()
+    {
+        viewDirty = true;
+    }
+
+    bool needsRedraw(const GridSnapshot& latest) const
+    {
+        return viewDirty || needsRebuild || latest.sequence != presentedSequence;
+    }
+
+    void setMode(RenderMode newMode)
+    {
+        if (newMode == mode) return;
+        mode = newMode;
+        needsRebuild = true;
+    }
+
+    void toggleMode()
     {
+        setMode(mode == RenderMode::Vertices ? RenderMode::Texture : RenderMode::Vertices);
     }
 
-    void render()
+    void setColorMode(ColorMode newMode)
     {
+        if (newMode == colorMode) return;
+        colorMode = newMode;
+        needsRebuild = true;
+    }
+
+    void toggleColorMode()
+    {
+        setColorMode(colorMode == ColorMode::Age ? ColorMode::Tiles : ColorMode::Age);
+    }
+
+    void resetCamera()
+    {
+        invalidate();
+        zoom = 1.f;
+        camera = sf::View(sf::FloatRect(0.f, 0.f, static_cast<float>(window.getSize().x), static_cast<float>(window.getSize().y)));
+    }
+
+    void onResize(unsigned int width, unsigned int height)
+    {
+        invalidate();
+        camera.setSize(width * zoom, height * zoom);
+    }
+
+    // zooms by factor keeping the world point under the given pixel in place
+    void zoomAt(sf::Vector2i pixel, float factor)
+    {
+        float newZoom = std::max(minZoom, std::min(maxZoom, zoom * factor));
+        factor = newZoom / zoom;
+        zoom = newZoom;
+
+        sf::Vector2f before = window.mapPixelToCoords(pixel, camera);
+        camera.zoom(factor);
+        sf::Vector2f after = window.mapPixelToCoords(pixel, camera);
+        camera.move(before - after);
+        invalidate();
+    }
+
+    void pan(sf::Vector2i pixelDelta)
+    {
+        if (pixelDelta == sf::Vector2i()) return;
+        invalidate();
+        camera.move(-pixelDelta.x * zoom, -pixelDelta.y * zoom);
+    }
+
+    // tile under a window pixel, false when the pixel is off the board
+    bool pixelToTile(sf::Vector2i pixel, int& i, int& j)
+    {
+        sf::Vector2f world = window.mapPixelToCoords(pixel, camera);
+        if (world.x < 0 || world.y < 0 || !snapshot) return false;
+
+        i = static_cast<int>(world.x / tileSize);
+        j = static_cast<int>(world.y / tileSize);
+        return i < snapshot->columns && j < snapshot->rows;
+    }
+
+    void render(const GridSnapshot& latest)
+    {
+        snapshot = &latest;
+        window.setView(camera);
         renderGrid();
         renderTiles();
         window.display();
+
+        presentedSequence = latest.sequence;
+        viewDirty = false;
     }
 
     void renderGrid()
     {
         window.clear(sf::Color::Black);
 
-        const int numLinesX = window.getSize().x / tileSize + 1;
-        const int numLinesY = window.getSize().y / tileSize + 1;
-        const int totalVertices = 2 * (numLinesX + numLinesY);
+        // lines closer than a few pixels just turn the board grey, skip them
+        if (tilePixelSize() < minGridLinePixels) return;
+
+        sf::View view = window.getView();
+        if (!overlayValid || window.getSize() != overlaySize || view.getSize() != overlayViewSize)
+            buildGridOverlay();
 
-        sf::VertexArray lines(sf::Lines, totalVertices);
-        int index = 0;
+        // the lines repeat every tile, so panning only moves the overlay to the tile the view's corner is in
+        sf::Vector2f center = view.getCenter();
+        sf::Vector2f size = view.getSize();
+        overlaySprite.setPosition(std::floor((center.x - size.x / 2) / tileSize) * tileSize,
+            std::floor((center.y - size.y / 2) / tileSize) * tileSize);
+        window.draw(overlaySprite);
+    }
+
+    // on screen size of one tile in pixels under the current view
+    float tilePixelSize()
+    {
+        return tileSize * window.getSize().x / window.getView().getSize().x;
+    }
+
+    // the lines only change with the window size or the zoom, so they are drawn once into an offscreen
+    // texture in world space and that texture is redrawn every frame with the view
+    // it covers a screen plus one tile, starting on a tile corner, so any pan is covered by moving it
+    void buildGridOverlay()
+    {
+        sf::View view = window.getView();
+        overlaySize = window.getSize();
+        overlayViewSize = view.getSize();
+
+        // same pixels per world unit as the window so the lines come out 1:1
+        float pixelsX = overlaySize.x / overlayViewSize.x;
+        float pixelsY = overlaySize.y / overlayViewSize.y;
+        unsigned width = static_cast<unsigned>(std::ceil((overlayViewSize.x + tileSize) * pixelsX));
+        unsigned height = static_cast<unsigned>(std::ceil((overlayViewSize.y + tileSize) * pixelsY));
+        float right = width / pixelsX;
+        float bottom = height / pixelsY;
+        float left = 0;
+        float top = 0;
+
+        overlayTexture.create(width, height);
+        overlayTexture.setView(sf::View(sf::FloatRect(left, top, right, bottom)));
+        overlayTexture.clear(sf::Color::Transparent);
+
+        sf::VertexArray lines(sf::Lines);
 
         // horizontal lines
-        for (size_t i = 0; i <= window.getSize().y; i += tileSize)
+        for (float y = top; y <= bottom; y += tileSize)
         {
-            lines[index++] = sf::Vertex(sf::Vector2f(0, i), sf::Color(255, 255, 255, 255));
-            lines[index++] = sf::Vertex(sf::Vector2f(window.getSize().x, i), sf::Color(255, 255, 255, 255));
+            lines.append(sf::Vertex(sf::Vector2f(left, y), sf::Color(255, 255, 255, 255)));
+            lines.append(sf::Vertex(sf::Vector2f(right, y), sf::Color(255, 255, 255, 255)));
         }
 
-        for (size_t i = 0; i <= window.getSize().x; i += tileSize)
+        for (float x = left; x <= right; x += tileSize)
         {
-            lines[index++] = sf::Vertex(sf::Vector2f(i, 0), sf::Color(255, 255, 255, 255));
-            lines[index++] = sf::Vertex(sf::Vector2f(i, window.getSize().y), sf::Color(255, 255, 255, 255));
+            lines.append(sf::Vertex(sf::Vector2f(x, top), sf::Color(255, 255, 255, 255)));
+            lines.append(sf::Vertex(sf::Vector2f(x, bottom), sf::Color(255, 255, 255, 255)));
         }
-        window.draw(lines);
+        overlayTexture.draw(lines);
+        overlayTexture.display();
+
+        overlaySprite.setTexture(overlayTexture.getTexture(), true);
+        overlaySprite.setScale(right / width, bottom / height);
+        overlayValid = true;
     }
 
-    void renderTiles() 
+    // works out which tiles changed since the last drawn snapshot
+    void collectDirty()
     {
-        // create vector of square objects for batch drawing optimization
-        sf::VertexArray squares(sf::Triangles);
+        dirty.clear();
+        if (snapshot->sequence == drawnSequence) return;
 
-        // create a square to be drawn on line-based grid
-        sf::RectangleShape square(sf::Vector2f(tileSize, tileSize));
-
-        for (size_t i = 0; i < grid.tiles.size(); i++)
+        if (colorMode == ColorMode::Age)
         {
-            for (size_t j = 0; j < grid.tiles[i].size(); j++)
+            bool withAges = !snapshot->ages.empty();
+            if (snapshot->sequence == drawnSequence + 1 && withAges == drawnWithAges)
             {
-                // extract tile from vector-based grid
-                Tile& tile = grid.tiles[i][j];
+                for (size_t index : snapshot->dirty)
+                    recolor(index);
+            }
+            else
+            {
+                for (size_t index = 0; index < snapshot->alive.size(); index++)
+                    recolor(index);
+                drawnWithAges = withAges;
+            }
+        }
+        else if (snapshot->sequence == drawnSequence + 1)
+        {
+            // the simulation's own dirty list is exact when no snapshot was skipped
+            dirty.assign(snapshot->dirty.begin(), snapshot->dirty.end());
+        }
+        else
+        {
+            for (size_t index = 0; index < snapshot->alive.size(); index++)
+                if (snapshot->alive[index] != drawnAlive[index])
+                    dirty.push_back(index);
+        }
+
+        for (size_t index : dirty)
+            drawnAlive[index] = snapshot->alive[index];
+        drawnSequence = snapshot->sequence;
+    }
+
+    // heatmap only, lists the tile if its color moved since it was drawn
+    void recolor(size_t index)
+    {
+        sf::Uint32 color = tileColor(index).toInteger();
+        if (color != drawnColors[index])
+        {
+            drawnColors[index] = color;
+            dirty.push_back(index);
+        }
+    }
+
+    // tile vertices live in a persistent buffer, built once, after that only the colors
+    // of tiles that changed get patched and uploaded
+    void buildTiles()
+    {
+        size_t columns = snapshot->columns;
+        size_t rows = snapshot->rows;
 
-                float x = tile.x * tileSize;
-                float y = tile.y * tileSize;
+        tileVertices.clear();
+        tileVertices.reserve(columns * rows * 6);
+
+        for (size_t i = 0; i < columns; i++)
+        {
+            for (size_t j = 0; j < rows; j++)
+            {
+                float x = static_cast<float>(i * tileSize);
+                float y = static_cast<float>(j * tileSize);
+                sf::Color color = tileColor(i * rows + j);
 
                 // define vertices of the square
-                squares.append(sf::Vertex(sf::Vector2f(x, y), sf::Color::Black));
-                squares.append(sf::Vertex(sf::Vector2f(x + tileSize, y), sf::Color::Black));
-                squares.append(sf::Vertex(sf::Vector2f(x, y + tileSize), sf::Color::Black));
+                tileVertices.emplace_back(sf::Vector2f(x, y), color);
+                tileVertices.emplace_back(sf::Vector2f(x + tileSize, y), color);
+                tileVertices.emplace_back(sf::Vector2f(x, y + tileSize), color);
+
+                tileVertices.emplace_back(sf::Vector2f(x + tileSize, y), color);
+                tileVertices.emplace_back(sf::Vector2f(x + tileSize, y + tileSize), color);
+                tileVertices.emplace_back(sf::Vector2f(x, y + tileSize), color);
+            }
+        }
 
-                squares.append(sf::Vertex(sf::Vector2f(x + tileSize, y), sf::Color::Black));
-                squares.append(sf::Vertex(sf::Vector2f(x + tileSize, y + tileSize), sf::Color::Black));
-                squares.append(sf::Vertex(sf::Vector2f(x, y + tileSize), sf::Color::Black));
+        if (useVertexBuffer)
+        {
+            tileBuffer.create(tileVertices.size());
+            tileBuffer.update(tileVertices.data());
+        }
+    }
 
-                // Set square color based on tile state
-                if (tile.isAlive)
-                {
-                    // Change color if the tile is alive
-                    for (int k = 0; k < 6; ++k)
-                        squares[squares.getVertexCount() - k - 1].color = sf::Color(255, 255, 255, 240);
-                }
-                else
+    sf::Color tileColor(size_t index)
+    {
+        bool alive = snapshot->alive[index];
+        if (colorMode == ColorMode::Age)
+        {
+            // same alpha as the plain colors so the grid lines still show through
+            // the ages only come with the snapshots published after switching to these colors
+            uint8_t age = index < snapshot->ages.size() ? snapshot->ages[index] : CellAge::maxAge;
+            const uint8_t* rgb = CellAge::Palette::get().color(alive, age);
+            return sf::Color(rgb[0], rgb[1], rgb[2], alive ? 240 : 210);
+        }
+
+        // white if the tile is alive, black if it is dead
+        return alive ? sf::Color(255, 255, 255, 240) : sf::Color(0, 0, 0, 210);
+    }
+
+    void patchDirtyTiles()
+    {
+        if (dirty.empty()) return;
+
+        for (size_t index : dirty)
+        {
+            sf::Color color = tileColor(index);
+            for (size_t k = 0; k < 6; k++)
+                tileVertices[index * 6 + k].color = color;
+        }
+
+        if (useVertexBuffer)
+        {
+            // a big change is cheaper as one upload than as many small ones
+            if (dirty.size() * 4 > tileVertices.size() / 6)
+            {
+                tileBuffer.update(tileVertices.data());
+            }
+            else
+            {
+                // upload runs of neighboring tiles together
+                std::sort(dirty.begin(), dirty.end());
+                size_t runBegin = dirty[0];
+                size_t runEnd = dirty[0] + 1;
+                for (size_t k = 1; k <= dirty.size(); k++)
                 {
-                    // Change color if the tile is dead
-                    for (int k = 0; k < 6; ++k)
-                        squares[squares.getVertexCount() - k - 1].color = sf::Color(0, 0, 0, 210);
+                    if (k < dirty.size() && dirty[k] == runEnd)
+                    {
+                        runEnd++;
+                        continue;
+                    }
+                    tileBuffer.update(&tileVertices[runBegin * 6], (runEnd - runBegin) * 6, static_cast<unsigned int>(runBegin * 6));
+                    if (k < dirty.size())
+                    {
+                        runBegin = dirty[k];
+                        runEnd = dirty[k] + 1;
+                    }
                 }
+            }
+        }
+    }
+
+    // each tile becomes one pixel, a scaled sprite without smoothing turns it back into a square
+    void buildTexture()
+    {
+        unsigned int columns = static_cast<unsigned int>(snapshot->columns);
+        unsigned int rows = static_cast<unsigned int>(snapshot->rows);
+        pieceSize = sf::Texture::getMaximumSize();
 
+        // reserve up front, copying a piece would copy its texture on the gpu
+        texturePieces.clear();
+        texturePieces.reserve(static_cast<size_t>((columns + pieceSize - 1) / pieceSize) * ((rows + pieceSize - 1) / pieceSize));
+        for (unsigned int y0 = 0; y0 < rows; y0 += pieceSize)
+        {
+            for (unsigned int x0 = 0; x0 < columns; x0 += pieceSize)
+            {
+                texturePieces.emplace_back();
+                TexturePiece& piece = texturePieces.back();
+                piece.x0 = x0;
+                piece.y0 = y0;
+                piece.width = std::min(pieceSize, columns - x0);
+                piece.height = std::min(pieceSize, rows - y0);
+                piece.pixels.resize(static_cast<size_t>(piece.width) * piece.height * 4);
+                piece.dirtyBegin = piece.height;
+                piece.dirtyEnd = 0;
+
+                for (unsigned int y = 0; y < piece.height; y++)
+                    for (unsigned int x = 0; x < piece.width; x++)
+                        writePixel(piece, x, y, tileColor(static_cast<size_t>(x0 + x) * rows + y0 + y));
+
+                piece.texture.create(piece.width, piece.height);
+                piece.texture.setSmooth(false);
+                piece.texture.update(piece.pixels.data());
             }
         }
-        // draw square on line-based grid based on position in vector-based grid
-        window.draw(squares);
+
+        // sprites point at their texture, so hook them up once the vector stopped moving
+        for (TexturePiece& piece : texturePieces)
+        {
+            piece.sprite.setTexture(piece.texture, true);
+            piece.sprite.setPosition(static_cast<float>(piece.x0 * tileSize), static_cast<float>(piece.y0 * tileSize));
+            piece.sprite.setScale(static_cast<float>(tileSize), static_cast<float>(tileSize));
+        }
+    }
+
+    void writePixel(TexturePiece& piece, unsigned int x, unsigned int y, sf::Color color)
+    {
+        sf::Uint8* pixel = &piece.pixels[(static_cast<size_t>(y) * piece.width + x) * 4];
+        pixel[0] = color.r;
+        pixel[1] = color.g;
+        pixel[2] = color.b;
+        pixel[3] = color.a;
+    }
+
+    void patchDirtyPixels()
+    {
+        if (dirty.empty()) return;
+
+        size_t rows = snapshot->rows;
+        size_t piecesPerRow = (snapshot->columns + pieceSize - 1) / pieceSize;
+        for (size_t index : dirty)
+        {
+            unsigned int i = static_cast<unsigned int>(index / rows);
+            unsigned int j = static_cast<unsigned int>(index % rows);
+            TexturePiece& piece = texturePieces[(j / pieceSize) * piecesPerRow + i / pieceSize];
+
+            unsigned int y = j - piece.y0;
+            writePixel(piece, i - piece.x0, y, tileColor(index));
+            piece.dirtyBegin = std::min(piece.dirtyBegin, y);
+            piece.dirtyEnd = std::max(piece.dirtyEnd, y + 1);
+        }
+
+        // upload the band of rows that changed in each piece, one call per piece
+        for (TexturePiece& piece : texturePieces)
+        {
+            if (piece.dirtyBegin >= piece.dirtyEnd) continue;
+            piece.texture.update(&piece.pixels[static_cast<size_t>(piece.dirtyBegin) * piece.width * 4],
+                piece.width, piece.dirtyEnd - piece.dirtyBegin, 0, piece.dirtyBegin);
+            piece.dirtyBegin = piece.height;
+            piece.dirtyEnd = 0;
+        }
+    }
+
+    // coarsest density level whose blocks are still about a pixel on screen, null when zoomed in enough to draw tiles
+    const DensityLevel* densityLevelForZoom()
+    {
+        const DensityLevel* chosen = nullptr;
+        for (const DensityLevel& level : snapshot->densityLevels)
+            if (tilePixelSize() * level.block <= 1.f)
+                chosen = &level;
+        return chosen;
+    }
+
+    // draws the visible blocks of one density level as a grey pixel each, the cost follows the
+    // number of blocks on screen rather than the size of the board
+    void renderDensity(const DensityLevel& level)
+    {
+        float blockWorld = static_cast<float>(level.block * tileSize);
+        sf::Vector2f center = camera.getCenter();
+        sf::Vector2f size = camera.getSize();
+
+        int bx0 = std::max(0, static_cast<int>(std::floor((center.x - size.x / 2) / blockWorld)));
+        int by0 = std::max(0, static_cast<int>(std::floor((center.y - size.y / 2) / blockWorld)));
+        int bx1 = std::min(level.columns, static_cast<int>(std::ceil((center.x + size.x / 2) / blockWorld)));
+        int by1 = std::min(level.rows, static_cast<int>(std::ceil((center.y + size.y / 2) / blockWorld)));
+        if (bx0 >= bx1 || by0 >= by1) return;
+
+        unsigned int width = static_cast<unsigned int>(bx1 - bx0);
+        unsigned int height = static_cast<unsigned int>(by1 - by0);
+        densityPixels.resize(static_cast<size_t>(width) * height * 4);
+
+        float cellsPerBlock = static_cast<float>(level.block * level.block);
+        for (unsigned int y = 0; y < height; y++)
+        {
+            for (unsigned int x = 0; x < width; x++)
+            {
+                uint16_t count = level.counts[static_cast<size_t>(bx0 + x) * level.rows + by0 + y];
+                sf::Uint8 shade = static_cast<sf::Uint8>(255.f * std::min(1.f, count / cellsPerBlock * 2.f));
+                sf::Uint8* pixel = &densityPixels[(static_cast<size_t>(y) * width + x) * 4];
+                pixel[0] = pixel[1] = pixel[2] = shade;
+                pixel[3] = 255;
+            }
+        }
+
+        if (densityTexture.getSize() != sf::Vector2u(width, height))
+        {
+            densityTexture.create(width, height);
+            densityTexture.setSmooth(false);
+        }
+        densityTexture.update(densityPixels.data());
+
+        densitySprite.setTexture(densityTexture, true);
+        densitySprite.setPosition(bx0 * blockWorld, by0 * blockWorld);
+        densitySprite.setScale(blockWorld, blockWorld);
+        window.draw(densitySprite);
+    }
+
+    void renderTiles() 
+    {
+        // far out the pyramid is enough, the tile buffers catch up by diffing once we zoom back in
+        if (const DensityLevel* level = densityLevelForZoom())
+        {
+            renderDensity(*level);
+            return;
+        }
+
+        if (needsRebuild)
+        {
+            drawnAlive = snapshot->alive;
+            drawnSequence = snapshot->sequence;
+            dirty.clear();
+            if (colorMode == ColorMode::Age)
+            {
+                drawnColors.resize(snapshot->alive.size());
+                for (size_t index = 0; index < drawnColors.size(); index++)
+                    drawnColors[index] = tileColor(index).toInteger();
+                drawnWithAges = !snapshot->ages.empty();
+            }
+
+            if (mode == RenderMode::Vertices)
+                buildTiles();
+            else
+                buildTexture();
+            needsRebuild = false;
+        }
+        else
+        {
+            collectDirty();
+        }
+
+        if (mode == RenderMode::Texture)
+        {
+            patchDirtyPixels();
+            for (TexturePiece& piece : texturePieces)
+                window.draw(piece.sprite);
+            return;
+        }
+
+        patchDirtyTiles();
+
+        // draw every square in one call
+        if (useVertexBuffer)
+            window.draw(tileBuffer);
+        else
+            window.draw(tileVertices.data(), tileVertices.size(), sf::Triangles);
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,92 @@
+#pragma once
+#include "SoftwareRenderer.hpp"
+#include <cstdint>
+#include <deque>
+
+// the recent past of the windowed game, for stepping backward
+// keeps bit-packed keyframes of the board (a bit per tile) in generation order, the simulation takes one
+// once the stepping since the last one reaches its replay budget (rewindReplayBudget seconds or
+// rewindKeyframeEvery generations), and after edits only lazily: an edit marks a keyframe due
+// (Simulation::keyframeDue) and it's taken just before the next step, so a burst of edits while paused
+// costs one keyframe and stepping forward from a keyframe still gives back the board the user saw
+// a keyframe replaces any at its generation or later, a new one after stepping back (or editing the board
+// at an earlier generation) throws away the old future
+// stepping back restores the newest keyframe at or before the target and steps forward from there, so
+// it costs at most the stepping between two keyframes however far back it goes
+// the oldest keyframes are dropped (and their memory reused) to stay under the budget
+
+struct RewindBuffer
+{
+	size_t memoryBudget;
+	std::deque<BitFrame> keyframes; // oldest first
+	size_t bytes = 0;
+
+	RewindBuffer(size_t budget) : memoryBudget(budget)
+	{
+	}
+
+	bool empty() const
+	{
+		return keyframes.empty();
+	}
+
+	// furthest back stepping can go
+	uint64_t oldest() const
+	{
+		return keyframes.empty() ? 0 : keyframes.front().generation;
+	}
+
+	// fill(frame) copies the board into the frame it is handed
+	// a keyframe replaces any taken at the same generation or later (edits after stepping back start a new future)
+	template <typename Fill>
+	void capture(uint64_t generation, Fill fill)
+	{
+		dropFrom(generation);
+
+		BitFrame frame;
+		if (keyframes.size() > 1 && bytes + frameBytes(keyframes.back()) > memoryBudget)
+		{
+			// another one wouldn't fit, the oldest goes and its buffer is refilled (the newest always stays)
+			frame = std::move(keyframes.front());
+			bytes -= frameBytes(frame);
+			keyframes.pop_front();
+		}
+		fill(frame);
+		frame.generation = generation;
+		bytes += frameBytes(frame);
+		keyframes.push_back(std::move(frame));
+
+		while (keyframes.size() > 1 && bytes > memoryBudget)
+		{
+			bytes -= frameBytes(keyframes.front());
+			keyframes.pop_front();
+		}
+	}
+
+	// newest keyframe at or before generation (or the oldest one if generation is further back than that),
+	// the ones after it are dropped, that future is about to be stepped again
+	// nullptr if there are none
+	const BitFrame* rewindTo(uint64_t generation)
+	{
+		if (keyframes.empty()) return nullptr;
+		if (generation < oldest())
+			generation = oldest();
+		dropFrom(generation + 1);
+		return &keyframes.back();
+	}
+
+	// drops the keyframes of generation and later
+	void dropFrom(uint64_t generation)
+	{
+		while (!keyframes.empty() && keyframes.back().generation >= generation)
+		{
+			bytes -= frameBytes(keyframes.back());
+			keyframes.pop_back();
+		}
+	}
+
+	static size_t frameBytes(const BitFrame& frame)
+	{
+		return frame.words.capacity() * sizeof(uint64_t);
+	}
+};
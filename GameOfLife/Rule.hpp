@@ -0,0 +1,97 @@
+#pragma once
+#include <cctype>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+// outer totalistic life-like rule, bit n of birth / survival is set when n live neighbors
+// make a dead tile come alive / keep a live tile alive
+// parses "B3/S23" style strings (any case) and the older "23/3" survival/birth form
+
+struct Rule
+{
+	uint16_t birth = 1 << 3;
+	uint16_t survival = (1 << 2) | (1 << 3);
+
+	bool births(int neighbors) const
+	{
+		return (birth >> neighbors) & 1;
+	}
+
+	bool survives(int neighbors) const
+	{
+		return (survival >> neighbors) & 1;
+	}
+
+	bool isConway() const
+	{
+		return birth == (1 << 3) && survival == ((1 << 2) | (1 << 3));
+	}
+
+	bool operator==(const Rule& other) const
+	{
+		return birth == other.birth && survival == other.survival;
+	}
+
+	bool operator!=(const Rule& other) const
+	{
+		return !(*this == other);
+	}
+
+	static uint16_t parseDigits(const std::string& digits, const std::string& text)
+	{
+		uint16_t mask = 0;
+		for (char c : digits)
+		{
+			if (c < '0' || c > '8')
+				throw std::invalid_argument("Rule: bad neighbor count in \"" + text + "\"");
+			mask |= static_cast<uint16_t>(1 << (c - '0'));
+		}
+		return mask;
+	}
+
+	static Rule parse(const std::string& text)
+	{
+		size_t slash = text.find('/');
+		if (slash == std::string::npos)
+			throw std::invalid_argument("Rule: expected B.../S... in \"" + text + "\"");
+
+		std::string left = text.substr(0, slash);
+		std::string right = text.substr(slash + 1);
+
+		Rule rule;
+		char first = static_cast<char>(std::toupper(static_cast<unsigned char>(left.empty() ? '\0' : left[0])));
+		if (first == 'B')
+		{
+			if (right.empty() || std::toupper(static_cast<unsigned char>(right[0])) != 'S')
+				throw std::invalid_argument("Rule: expected B.../S... in \"" + text + "\"");
+			rule.birth = parseDigits(left.substr(1), text);
+			rule.survival = parseDigits(right.substr(1), text);
+		}
+		else if (first == 'S')
+		{
+			if (right.empty() || std::toupper(static_cast<unsigned char>(right[0])) != 'B')
+				throw std::invalid_argument("Rule: expected S.../B... in \"" + text + "\"");
+			rule.survival = parseDigits(left.substr(1), text);
+			rule.birth = parseDigits(right.substr(1), text);
+		}
+		else
+		{
+			// survival/birth without letters, e.g. 23/3
+			rule.survival = parseDigits(left, text);
+			rule.birth = parseDigits(right, text);
+		}
+		return rule;
+	}
+
+	std::string toString() const
+	{
+		std::string text = "B";
+		for (int n = 0; n <= 8; n++)
+			if (births(n)) text += static_cast<char>('0' + n);
+		text += "/S";
+		for (int n = 0; n <= 8; n++)
+			if (survives(n)) text += static_cast<char>('0' + n);
+		return text;
+	}
+};
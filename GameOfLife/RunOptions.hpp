@@ -0,0 +1,359 @@
+#pragma once
+#include "Constants.hpp"
+#include "Rule.hpp"
+#include "CheckpointWriter.hpp"
+#include "FrameRecorder.hpp"
+#include "SoftwareRenderer.hpp"
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+// command line options, shared by the window and the headless batch runner
+// with no arguments the game starts exactly like it always has
+
+struct RunOptions
+{
+	bool help = false;
+	bool headless = false;
+
+	std::string engine = "parallel"; // headless only: grid, parallel, morton, chunked or mapped
+	bool engineGiven = false; // otherwise a resumed checkpoint picks the engine that wrote it
+	int width = totalGridTiles;
+	int height = totalGridTiles;
+	Rule rule;
+	bool ruleGiven = false; // --rule wins over the rule in an rle file
+
+	// starting board, a pattern file wins over a random fill, neither keeps the old random start
+	std::string patternPath;
+	int64_t patternX = 0; // top left corner of the pattern, centered on the board unless patternPlaced
+	int64_t patternY = 0;
+	bool patternPlaced = false;
+	bool seeded = false;
+	uint64_t seed = 0;
+	double density = 0.5;
+
+	// windowed hyperspeed, see Simulation
+	int stepsPerFrame = generationsPerFrame;
+	double frameBudget = hyperspeedFrameBudget;
+	size_t rewindMemory = rewindMemoryBudget; // keyframes kept for stepping back in the window
+	size_t undoMemory = undoMemoryBudget; // undo / redo steps kept for edits in the window
+	std::string libraryPath; // directory of patterns to browse in the window, see PatternLibrary
+
+	// headless run control
+	uint64_t generations = 100;
+	uint64_t reportEvery = 0; // 0 only reports the end of the run
+	std::string outputPath; // final board, format from the extension
+	std::string statsPath; // progress lines, empty = stdout
+	std::string generationStatsPath; // a line per generation, csv or jsonl
+	std::string boardFile; // backing file for the mapped engine
+	std::string resumePath; // checkpoint to carry on from, its size, rule and generation win
+	std::string checkpointPath; // checkpoint written at the end of the run, and along the way with these
+	uint64_t checkpointEvery = 0;
+	uint64_t checkpointSeconds = 0;
+	std::string historyPath; // every generation of the run, see History
+	uint64_t keyframeEvery = 64;
+	std::string replayPath; // history to start from, at replayGeneration
+	uint64_t replayGeneration = UINT64_MAX; // the last one recorded
+	int threads = 0;
+	bool pinThreads = false; // parallel engine, see ParallelGridOptions
+	bool hugePages = false;
+
+	// picture of the final board drawn on the cpu, .png or raw rgb otherwise
+	std::string imagePath;
+	RasterOptions raster;
+
+	// movie of the run, every Nth generation drawn the same way as --image
+	std::string recordTarget; // directory for a png sequence, "-" for raw rgb on stdout
+	uint64_t recordEvery = 1;
+	int encoders = 0;
+	size_t recordQueue = 8;
+
+	RecorderOptions recorderOptions() const
+	{
+		RecorderOptions recorder;
+		recorder.target = recordTarget;
+		recorder.every = recordEvery;
+		recorder.encoders = encoders;
+		recorder.queueFrames = recordQueue;
+		recorder.raster = raster;
+		return recorder;
+	}
+
+	CheckpointWriterOptions checkpointOptions() const
+	{
+		CheckpointWriterOptions checkpoints;
+		checkpoints.path = checkpointPath;
+		checkpoints.every = checkpointEvery;
+		checkpoints.seconds = static_cast<double>(checkpointSeconds);
+		return checkpoints;
+	}
+};
+
+inline const char* usageText()
+{
+	return
+		"usage: GameOfLife [options]\n"
+		"  --headless             run without a window\n"
+		"  --engine NAME          grid, parallel, morton, chunked or mapped (headless, default parallel)\n"
+		"  --size WxH             board size in tiles\n"
+		"  --rule B3/S23          life-like rule\n"
+		"  --pattern FILE         starting pattern (.cells, .rle or .mc)\n"
+		"  --at X,Y               where the pattern's top left goes, centered by default\n"
+		"  --seed N               random start from seed N\n"
+		"  --density D            live fraction of the random start (default 0.5)\n"
+		"  --steps-per-frame N    generations per drawn frame in the window, auto fits a time budget\n"
+		"  --frame-budget MS      milliseconds of stepping per frame for auto (default 12)\n"
+		"  --rewind-memory MB     memory for stepping back with Backspace in the window (default 64)\n"
+		"  --undo-memory MB       memory for undoing edits with Ctrl+Z in the window (default 16)\n"
+		"  --library DIR          pattern files to browse with L in the window and place with a click\n"
+		"  --generations N        generations to run headless (default 100)\n"
+		"  --report N             print progress every N generations\n"
+		"  --stats FILE           progress and summary go here instead of stdout\n"
+		"  --generation-stats FILE  population, births, deaths, bounding box and step time of every generation (.csv or .jsonl)\n"
+		"  --output FILE          save the final board (.cells, .rle or .mc)\n"
+		"  --image FILE           picture of the final board, .png or raw rgb (any other extension)\n"
+		"  --scale N | 1/N        N pixels per cell, or N cells per pixel for thumbnails (default 1)\n"
+		"  --color MODE           tiles, density or age (heatmap of how long cells kept their state)\n"
+		"  --record DIR | -       record frames as DIR/frame_000000.png ..., or raw rgb on stdout with -\n"
+		"  --record-every N       record every Nth generation (default 1)\n"
+		"  --encoders N           frame encoder threads (default one per core, less one)\n"
+		"  --record-queue N       frames waiting to be encoded before new ones are dropped (default 8)\n"
+		"  --checkpoint FILE      save a binary checkpoint of the final board\n"
+		"  --checkpoint-every N   also checkpoint every N generations, written in the background\n"
+		"  --checkpoint-seconds T also checkpoint every T seconds, written in the background\n"
+		"  --resume FILE          carry on from a checkpoint (its size, rule, generation and engine)\n"
+		"  --history FILE         record every generation, delta compressed with keyframes\n"
+		"  --keyframe-every K     full board every K generations of the history (default 64)\n"
+		"  --replay FILE          start from a generation of a recorded history\n"
+		"  --replay-at G          which generation to start from (default the last recorded)\n"
+		"  --board-file FILE      backing file for the mapped engine, kept between runs\n"
+		"  --threads N            worker threads for the parallel engine\n"
+		"  --pin-threads          pin each parallel engine worker to its own cpu\n"
+		"  --huge-pages           back the parallel engine's board with huge pages where the os allows it\n"
+		"  --help                 this text\n";
+}
+
+inline bool isEngineName(const std::string& name)
+{
+	return name == "grid" || name == "parallel" || name == "morton" || name == "chunked" || name == "mapped";
+}
+
+inline uint64_t parseCount(const std::string& option, const std::string& value)
+{
+	size_t used = 0;
+	unsigned long long parsed = 0;
+	try
+	{
+		parsed = std::stoull(value, &used);
+	}
+	catch (const std::exception&)
+	{
+		used = 0;
+	}
+	if (used == 0 || used != value.size() || value[0] == '-')
+		throw std::invalid_argument(option + ": expected a whole number, got \"" + value + "\"");
+	return parsed;
+}
+
+inline void parsePair(const std::string& option, const std::string& value, char separator, int64_t& first, int64_t& second)
+{
+	size_t split = value.find(separator);
+	if (split == std::string::npos)
+		throw std::invalid_argument(option + ": expected two numbers separated by '" + separator + "'");
+	try
+	{
+		size_t used = 0;
+		first = std::stoll(value.substr(0, split), &used);
+		if (used != split) throw std::invalid_argument("");
+		std::string rest = value.substr(split + 1);
+		second = std::stoll(rest, &used);
+		if (used != rest.size()) throw std::invalid_argument("");
+	}
+	catch (const std::exception&)
+	{
+		throw std::invalid_argument(option + ": expected two numbers separated by '" + separator + "', got \"" + value + "\"");
+	}
+}
+
+inline RunOptions parseRunOptions(int argc, char** argv)
+{
+	RunOptions options;
+	for (int n = 1; n < argc; n++)
+	{
+		std::string arg = argv[n];
+		auto value = [&]() -> std::string
+		{
+			if (n + 1 >= argc)
+				throw std::invalid_argument(arg + " needs a value");
+			return argv[++n];
+		};
+
+		if (arg == "--help" || arg == "-h")
+			options.help = true;
+		else if (arg == "--headless")
+			options.headless = true;
+		else if (arg == "--engine")
+		{
+			options.engine = value();
+			options.engineGiven = true;
+			if (!isEngineName(options.engine))
+				throw std::invalid_argument("--engine: unknown engine \"" + options.engine + "\"");
+		}
+		else if (arg == "--size")
+		{
+			int64_t width, height;
+			parsePair(arg, value(), 'x', width, height);
+			if (width <= 0 || height <= 0 || width > INT32_MAX || height > INT32_MAX)
+				throw std::invalid_argument("--size: dimensions must be between 1 and 2^31 - 1");
+			options.width = static_cast<int>(width);
+			options.height = static_cast<int>(height);
+		}
+		else if (arg == "--rule")
+		{
+			options.rule = Rule::parse(value());
+			options.ruleGiven = true;
+		}
+		else if (arg == "--pattern")
+			options.patternPath = value();
+		else if (arg == "--at")
+		{
+			parsePair(arg, value(), ',', options.patternX, options.patternY);
+			options.patternPlaced = true;
+		}
+		else if (arg == "--seed")
+		{
+			options.seed = parseCount(arg, value());
+			options.seeded = true;
+		}
+		else if (arg == "--density")
+		{
+			std::string text = value();
+			try
+			{
+				options.density = std::stod(text);
+			}
+			catch (const std::exception&)
+			{
+				options.density = -1;
+			}
+			if (!(options.density >= 0 && options.density <= 1))
+				throw std::invalid_argument("--density: expected a number between 0 and 1, got \"" + text + "\"");
+		}
+		else if (arg == "--steps-per-frame")
+		{
+			std::string text = value();
+			if (text == "auto")
+				options.stepsPerFrame = 0;
+			else
+				options.stepsPerFrame = static_cast<int>(parseCount(arg, text));
+			if (options.stepsPerFrame > maxGenerationsPerFrame)
+				throw std::invalid_argument("--steps-per-frame: at most " + std::to_string(maxGenerationsPerFrame));
+		}
+		else if (arg == "--frame-budget")
+		{
+			options.frameBudget = static_cast<double>(parseCount(arg, value())) / 1000.0;
+			if (options.frameBudget <= 0)
+				throw std::invalid_argument("--frame-budget: must be at least 1 ms");
+		}
+		else if (arg == "--generations")
+			options.generations = parseCount(arg, value());
+		else if (arg == "--report")
+			options.reportEvery = parseCount(arg, value());
+		else if (arg == "--stats")
+			options.statsPath = value();
+		else if (arg == "--output")
+			options.outputPath = value();
+		else if (arg == "--image")
+			options.imagePath = value();
+		else if (arg == "--scale")
+		{
+			std::string text = value();
+			if (text.compare(0, 2, "1/") == 0)
+			{
+				options.raster.cellPixels = 1;
+				options.raster.cellsPerPixel = static_cast<int>(parseCount(arg, text.substr(2)));
+			}
+			else
+			{
+				options.raster.cellPixels = static_cast<int>(parseCount(arg, text));
+				options.raster.cellsPerPixel = 1;
+			}
+			if (options.raster.cellPixels < 1 || options.raster.cellsPerPixel < 1)
+				throw std::invalid_argument("--scale: must be at least 1 or 1/1");
+		}
+		else if (arg == "--color")
+		{
+			std::string mode = value();
+			if (mode == "tiles")
+				options.raster.colorMode = ColorMode::Tiles;
+			else if (mode == "density")
+				options.raster.colorMode = ColorMode::Density;
+			else if (mode == "age")
+				options.raster.colorMode = ColorMode::Age;
+			else
+				throw std::invalid_argument("--color: unknown mode \"" + mode + "\"");
+		}
+		else if (arg == "--record")
+			options.recordTarget = value();
+		else if (arg == "--record-every")
+		{
+			options.recordEvery = parseCount(arg, value());
+			if (options.recordEvery == 0)
+				throw std::invalid_argument("--record-every: must be at least 1");
+		}
+		else if (arg == "--encoders")
+			options.encoders = static_cast<int>(parseCount(arg, value()));
+		else if (arg == "--record-queue")
+			options.recordQueue = static_cast<size_t>(parseCount(arg, value()));
+		else if (arg == "--resume")
+			options.resumePath = value();
+		else if (arg == "--checkpoint")
+			options.checkpointPath = value();
+		else if (arg == "--checkpoint-every")
+			options.checkpointEvery = parseCount(arg, value());
+		else if (arg == "--checkpoint-seconds")
+			options.checkpointSeconds = parseCount(arg, value());
+		else if (arg == "--rewind-memory")
+			options.rewindMemory = static_cast<size_t>(parseCount(arg, value())) << 20;
+		else if (arg == "--undo-memory")
+			options.undoMemory = static_cast<size_t>(parseCount(arg, value())) << 20;
+		else if (arg == "--library")
+			options.libraryPath = value();
+		else if (arg == "--generation-stats")
+			options.generationStatsPath = value();
+		else if (arg == "--history")
+			options.historyPath = value();
+		else if (arg == "--keyframe-every")
+		{
+			options.keyframeEvery = parseCount(arg, value());
+			if (options.keyframeEvery == 0 || options.keyframeEvery > UINT32_MAX)
+				throw std::invalid_argument("--keyframe-every: must be at least 1");
+		}
+		else if (arg == "--replay")
+			options.replayPath = value();
+		else if (arg == "--replay-at")
+			options.replayGeneration = parseCount(arg, value());
+		else if (arg == "--board-file")
+			options.boardFile = value();
+		else if (arg == "--threads")
+			options.threads = static_cast<int>(parseCount(arg, value()));
+		else if (arg == "--pin-threads")
+			options.pinThreads = true;
+		else if (arg == "--huge-pages")
+			options.hugePages = true;
+		else
+			throw std::invalid_argument("unknown option \"" + arg + "\"");
+	}
+
+	if (options.engine == "mapped" && options.headless && options.boardFile.empty())
+		throw std::invalid_argument("--engine mapped needs --board-file");
+	if (!options.resumePath.empty() && !options.replayPath.empty())
+		throw std::invalid_argument("--resume and --replay both choose the starting board, pick one");
+	if ((options.checkpointEvery > 0 || options.checkpointSeconds > 0) && options.checkpointPath.empty())
+		throw std::invalid_argument("--checkpoint-every and --checkpoint-seconds need --checkpoint");
+	if (options.headless && !options.libraryPath.empty())
+		throw std::invalid_argument("--library is browsed in the window, it does nothing headless");
+	if (options.raster.colorMode == ColorMode::Age && options.engine != "grid" && options.engine != "parallel")
+		throw std::invalid_argument("--color age: only the grid and parallel engines keep cell ages");
+	return options;
+}
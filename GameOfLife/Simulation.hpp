@@ -0,0 +1,532 @@
+#pragma once
+#include "FrameRecorder.hpp"
+#include "Grid.hpp"
+#include "PatternIO.hpp"
+#include "RewindBuffer.hpp"
+#include "TripleBuffer.hpp"
+#include "UndoHistory.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a finished generation as seen by the render thread
+struct GridSnapshot
+{
+	int columns = 0;
+	int rows = 0;
+	uint64_t sequence = 0; // counts publishes, a gap means the reader skipped snapshots
+	uint64_t generation = 0;
+	uint64_t editsApplied = 0; // edits the board reflects, behind Simulation::editsQueued while some are in flight
+	bool paused = true;
+
+	// the whole board, but publishing only copies in the tiles (and density blocks) that changed since this
+	// buffer was last written, see Simulation::publish
+	std::vector<uint8_t> alive; // index is i * rows + j like Grid's dirty list
+	std::vector<uint8_t> ages; // same index, for the age colors, only kept up to date while they're shown
+	std::vector<size_t> dirty; // tiles that changed since the previous snapshot
+	std::vector<DensityLevel> densityLevels;
+};
+
+// runs Grid::update on its own thread and publishes every generation through a triple buffer
+// the render thread only ever reads snapshots, edits from input are queued and applied by the
+// simulation thread between generations so the grid is never touched from two threads
+// in hyperspeed it steps a batch of generations per drawn frame instead and only publishes the last
+// one, either a fixed count or as many as the measured step time says fit in the frame budget
+// keyframes in a RewindBuffer let it step backward, one is taken whenever the stepping since the last one
+// adds up to rewindReplayBudget (or after rewindKeyframeEvery generations on a fast board), so stepping
+// back never replays longer than that
+// edits can be undone and redone (UndoHistory), an edit made before the board stepped on is undone by going
+// back to its generation first
+struct Simulation
+{
+	struct Edit
+	{
+		enum Type { ToggleTile, TogglePause, SetStepsPerFrame, StepBack, PlacePattern, Undo, Redo, PublishAges } type;
+		size_t i = 0;
+		size_t j = 0;
+		std::shared_ptr<const PatternIO::Pattern> pattern = nullptr; // PlacePattern, its top left goes on tile i, j
+	};
+
+	Grid& grid;
+	double targetRate; // generations per second, 0 runs as fast as possible
+
+	int stepsPerFrame = generationsPerFrame; // 1 = every generation, N = fixed batch, 0 = adaptive batch
+	double frameBudget = hyperspeedFrameBudget;
+	double framePeriod = 1.0 / renderFrameRate;
+	double averageStepSeconds = 0; // moving average, drives the adaptive batch size
+
+	TripleBuffer<GridSnapshot> snapshots;
+	uint64_t sequence = 0;
+	uint64_t generation = 0;
+
+	std::thread thread;
+	std::atomic<bool> running{ false };
+
+	std::mutex editMutex;
+	std::condition_variable editSignal;
+	std::vector<Edit> pendingEdits;
+	std::atomic<uint64_t> editsQueued{ 0 };
+	uint64_t editsApplied = 0;
+
+	// lets the render thread sleep until there's a new snapshot instead of polling for one
+	std::mutex publishMutex;
+	std::condition_variable publishSignal;
+	uint64_t publishedSequence = 0;
+
+	// what each of the triple buffer's snapshots is missing: every publish adds its dirty tiles to all three
+	// lists, writing a snapshot copies only its own list, and a list that grows past a quarter of the board
+	// (or a rewind) turns into a full copy instead
+	struct SnapshotChanges
+	{
+		std::vector<size_t> tiles;
+		std::vector<char> marks;
+		bool full = true;
+	};
+	SnapshotChanges snapshotChanges[3];
+	bool publishAges = false; // only copied while drawn, see setPublishAges
+
+	FrameRecorder* recorder = nullptr; // set before start() to record a movie of the run
+
+	RewindBuffer rewind;
+	double sinceKeyframeSeconds = 0; // stepping that would have to be replayed from the newest keyframe
+	uint64_t sinceKeyframeGenerations = 0;
+	bool keyframeDue = false; // edited since the last keyframe, taken before the next step instead of after every edit
+
+	UndoHistory undoHistory;
+	std::vector<size_t> flipped; // tiles the edit being applied flipped
+
+	Simulation(Grid& grid, double targetRate = simulationRate, size_t rewindBudget = rewindMemoryBudget, size_t undoBudget = undoMemoryBudget)
+		: grid(grid), targetRate(targetRate), rewind(rewindBudget), undoHistory(undoBudget)
+	{
+		keyframe();
+		publish(); // the first frame has something to draw
+	}
+
+	~Simulation()
+	{
+		stop();
+	}
+
+	void start()
+	{
+		running = true;
+		thread = std::thread(&Simulation::run, this);
+	}
+
+	void stop()
+	{
+		if (!running) return;
+		{
+			std::lock_guard<std::mutex> lock(editMutex);
+			running = false;
+		}
+		editSignal.notify_all();
+		thread.join();
+	}
+
+	// render thread side
+	const GridSnapshot& latest()
+	{
+		snapshots.update();
+		return snapshots.readBuffer();
+	}
+
+	void toggleTile(size_t i, size_t j)
+	{
+		pushEdit({ Edit::ToggleTile, i, j });
+	}
+
+	void togglePause()
+	{
+		pushEdit({ Edit::TogglePause });
+	}
+
+	void setStepsPerFrame(int steps)
+	{
+		pushEdit({ Edit::SetStepsPerFrame, static_cast<size_t>(steps), 0 });
+	}
+
+	// pauses and goes back count generations, or as far as the rewind buffer reaches
+	void stepBack(size_t count)
+	{
+		pushEdit({ Edit::StepBack, count, 0 });
+	}
+
+	// brings the pattern's live cells to life, the rest of the board under it stays as it is, cells past
+	// the edge of the board are left off
+	void placePattern(size_t i, size_t j, std::shared_ptr<const PatternIO::Pattern> pattern)
+	{
+		pushEdit({ Edit::PlacePattern, i, j, std::move(pattern) });
+	}
+
+	// pause and take the last edit back (or put it back again), going back to the generation it was made at
+	void undo()
+	{
+		pushEdit({ Edit::Undo });
+	}
+
+	void redo()
+	{
+		pushEdit({ Edit::Redo });
+	}
+
+	// the renderer shows the age colors, snapshots need the ages
+	// tiles that only got older are dirty too while they're on (Grid::dirtyAges), so they're copied like the states
+	void setPublishAges(bool on)
+	{
+		pushEdit({ Edit::PublishAges, on ? 1u : 0u, 0 });
+	}
+
+	void pushEdit(const Edit& edit)
+	{
+		{
+			std::lock_guard<std::mutex> lock(editMutex);
+			pendingEdits.push_back(edit);
+			editsQueued++;
+		}
+		editSignal.notify_all();
+	}
+
+	// true while an edit is queued or applied but not published yet, the screen is about to change
+	bool editsInFlight(const GridSnapshot& snapshot) const
+	{
+		return snapshot.editsApplied != editsQueued;
+	}
+
+	// blocks until a snapshot newer than seenSequence is published or the timeout runs out
+	void waitForPublish(uint64_t seenSequence, double seconds)
+	{
+		std::unique_lock<std::mutex> lock(publishMutex);
+		publishSignal.wait_for(lock, std::chrono::duration<double>(seconds), [&] { return publishedSequence > seenSequence; });
+	}
+
+	// simulation thread side
+	void run()
+	{
+		using clock = std::chrono::steady_clock;
+		auto nextTick = clock::now();
+		std::vector<Edit> edits;
+
+		while (running)
+		{
+			{
+				std::unique_lock<std::mutex> lock(editMutex);
+				// nothing to do while paused until an edit comes in
+				if (grid.gamePaused)
+					editSignal.wait(lock, [&] { return !running || !pendingEdits.empty(); });
+				edits.swap(pendingEdits);
+			}
+			if (!running) break;
+
+			bool changed = applyEdits(edits);
+
+			if (!grid.gamePaused)
+			{
+				stepBatch();
+				changed = true;
+			}
+
+			if (changed)
+				publish();
+
+			// a batch per drawn frame in hyperspeed, otherwise one generation per tick of the target rate
+			double period = stepsPerFrame != 1 ? framePeriod : (targetRate > 0 ? 1.0 / targetRate : 0);
+			if (period > 0 && !grid.gamePaused)
+			{
+				nextTick += std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(period));
+				if (stepsPerFrame != 1 && nextTick < clock::now())
+					nextTick = clock::now(); // batch overran the frame, don't try to catch up
+				std::this_thread::sleep_until(nextTick);
+			}
+			else
+			{
+				nextTick = clock::now();
+			}
+		}
+	}
+
+	// steps one generation, or a whole batch in hyperspeed
+	void stepBatch()
+	{
+		using clock = std::chrono::steady_clock;
+
+		int steps = stepsPerFrame;
+		if (steps == 0)
+			steps = averageStepSeconds > 0 ? static_cast<int>(std::min<double>(frameBudget / averageStepSeconds, maxGenerationsPerFrame)) : 1;
+		if (steps < 1) steps = 1;
+
+		// the edits since the last keyframe have to be in one before anything is stepped from them
+		if (keyframeDue)
+			keyframe();
+
+		auto begin = clock::now();
+		auto stepBegin = begin;
+		int done = 0;
+		while (done < steps)
+		{
+			grid.update();
+			generation++;
+			done++;
+			record();
+
+			auto stepEnd = clock::now();
+			sinceKeyframeSeconds += std::chrono::duration<double>(stepEnd - stepBegin).count();
+			sinceKeyframeGenerations++;
+			stepBegin = stepEnd;
+			if (sinceKeyframeSeconds >= rewindReplayBudget || sinceKeyframeGenerations >= rewindKeyframeEvery)
+				keyframe();
+
+			// the estimate can be off (the board got busier), stop once the budget is spent anyway
+			if (stepsPerFrame == 0 && std::chrono::duration<double>(clock::now() - begin).count() > frameBudget)
+				break;
+		}
+
+		double perStep = std::chrono::duration<double>(clock::now() - begin).count() / done;
+		averageStepSeconds = averageStepSeconds > 0 ? 0.8 * averageStepSeconds + 0.2 * perStep : perStep;
+	}
+
+	// only copies the board, the recorder never makes this thread wait
+	void record()
+	{
+		if (!recorder || !recorder->wants(generation)) return;
+		recorder->capture(generation, [&](BitFrame& frame)
+		{
+			int columns = static_cast<int>(grid.tiles.size());
+			int rows = static_cast<int>(grid.tiles[0].size());
+			frame.captureCells(columns, rows, [&](int i, int j) { return grid.isAlive(i, j); });
+			if (recorder->options.raster.colorMode == ColorMode::Age)
+				frame.captureAges(columns, rows, [&](int i, int j) { return grid.age(i, j); });
+		});
+	}
+
+	// bit-packed copy of the board for stepping back to this generation later
+	void keyframe()
+	{
+		rewind.capture(generation, [&](BitFrame& frame)
+		{
+			frame.captureCells(static_cast<int>(grid.tiles.size()), static_cast<int>(grid.tiles[0].size()),
+				[&](int i, int j) { return grid.isAlive(i, j); });
+		});
+		sinceKeyframeSeconds = 0;
+		sinceKeyframeGenerations = 0;
+		keyframeDue = false;
+	}
+
+	// restores the nearest keyframe and steps forward to the target, the board changes go through the grid's
+	// usual dirty tracking so the renderer picks them up like any other generation
+	// ages aren't in the keyframes, they start over as if the restored board had always been there
+	void rewindTo(uint64_t target)
+	{
+		const BitFrame* frame = rewind.rewindTo(target);
+		if (!frame) return;
+		if (target < frame->generation)
+			target = frame->generation; // can't go back further than the oldest keyframe
+
+		for (size_t i = 0; i < grid.tiles.size(); i++)
+		{
+			for (size_t j = 0; j < grid.tiles[i].size(); j++)
+			{
+				bool alive = (frame->row(static_cast<int>(j))[i >> 6] >> (i & 63)) & 1;
+				grid.setTile(i, j, alive);
+			}
+		}
+		grid.resetAges();
+		generation = frame->generation;
+
+		grid.gamePaused = false;
+		while (generation < target)
+		{
+			grid.update();
+			generation++;
+		}
+		grid.gamePaused = true;
+		sinceKeyframeSeconds = 0;
+		sinceKeyframeGenerations = generation - frame->generation;
+		keyframeDue = false; // edits made after this generation are gone with the board they were on
+		undoHistory.dropAfter(generation);
+		for (SnapshotChanges& changes : snapshotChanges)
+			changes.full = true;
+	}
+
+	size_t tileIndex(size_t i, size_t j) const
+	{
+		return i * grid.tiles[0].size() + j;
+	}
+
+	// undo or redo in O(tiles the edit flipped), unless the board stepped on since and has to go back first
+	// false if it's too far back for the rewind buffer, the undo history is of no use then
+	bool undoRedo(bool undo)
+	{
+		if (undo ? !undoHistory.canUndo() : !undoHistory.canRedo()) return false;
+		uint64_t made = undo ? undoHistory.undoGeneration() : undoHistory.redoGeneration();
+		if (made != generation)
+		{
+			rewindTo(made);
+			if (generation != made)
+			{
+				undoHistory.clear();
+				return false;
+			}
+		}
+
+		size_t rows = grid.tiles[0].size();
+		auto flip = [&](size_t index) { grid.toggleTile(index / rows, index % rows); };
+		if (undo)
+			undoHistory.undo(flip);
+		else
+			undoHistory.redo(flip);
+		grid.gamePaused = true;
+		return true;
+	}
+
+	bool applyEdits(std::vector<Edit>& edits)
+	{
+		bool changed = !edits.empty();
+		bool edited = false;
+		editsApplied += edits.size();
+		for (const Edit& edit : edits)
+		{
+			if (edit.type == Edit::ToggleTile)
+			{
+				grid.toggleTile(edit.i, edit.j);
+				flipped.assign(1, tileIndex(edit.i, edit.j));
+				undoHistory.record(generation, flipped);
+				edited = true;
+			}
+			else if (edit.type == Edit::PlacePattern)
+			{
+				flipped.clear();
+				for (const auto& cell : edit.pattern->cells)
+				{
+					uint64_t i = edit.i + static_cast<uint64_t>(cell.first);
+					uint64_t j = edit.j + static_cast<uint64_t>(cell.second);
+					if (i < grid.tiles.size() && j < grid.tiles[i].size() && !grid.isAlive(i, j))
+					{
+						grid.setTile(i, j, true);
+						flipped.push_back(tileIndex(i, j));
+					}
+				}
+				undoHistory.record(generation, flipped);
+				edited = true;
+			}
+			else if (edit.type == Edit::Undo || edit.type == Edit::Redo)
+			{
+				if (undoRedo(edit.type == Edit::Undo))
+					edited = true;
+			}
+			else if (edit.type == Edit::PublishAges)
+			{
+				publishAges = edit.i != 0;
+				grid.dirtyAges = publishAges;
+				// the ages were neither copied nor tracked while off, start every snapshot over
+				for (SnapshotChanges& changes : snapshotChanges)
+					changes.full = true;
+			}
+			else if (edit.type == Edit::SetStepsPerFrame)
+			{
+				stepsPerFrame = static_cast<int>(edit.i);
+			}
+			else if (edit.type == Edit::StepBack)
+			{
+				// stepping back over edits undoes them along with the generations
+				edited = false;
+				rewindTo(generation >= edit.i ? generation - edit.i : 0);
+			}
+			else
+			{
+				grid.gamePaused = !grid.gamePaused;
+			}
+		}
+		edits.clear();
+
+		// replaying from an older keyframe has to see the edits
+		if (edited)
+			keyframeDue = true;
+		return changed;
+	}
+
+	void publish()
+	{
+		GridSnapshot& snapshot = snapshots.writeBuffer();
+		snapshot.columns = static_cast<int>(grid.tiles.size());
+		snapshot.rows = static_cast<int>(grid.tiles[0].size());
+		snapshot.sequence = ++sequence;
+		snapshot.generation = generation;
+		snapshot.paused = grid.gamePaused;
+		snapshot.editsApplied = editsApplied;
+
+		size_t rows = grid.tiles[0].size();
+		size_t tiles = grid.tiles.size() * rows;
+
+		// this generation's changes are missing from every snapshot until it's written
+		for (SnapshotChanges& changes : snapshotChanges)
+		{
+			if (changes.full) continue;
+			for (size_t index : grid.dirtyTiles)
+			{
+				if (changes.marks[index]) continue;
+				changes.marks[index] = 1;
+				changes.tiles.push_back(index);
+			}
+			if (changes.tiles.size() > tiles / 4)
+			{
+				for (size_t index : changes.tiles)
+					changes.marks[index] = 0;
+				changes.tiles.clear();
+				changes.full = true;
+			}
+		}
+
+		SnapshotChanges& missing = snapshotChanges[snapshots.back];
+		if (missing.full || snapshot.alive.size() != tiles || (publishAges && snapshot.ages.size() != tiles))
+		{
+			snapshot.alive.resize(tiles);
+			size_t index = 0;
+			for (size_t i = 0; i < grid.tiles.size(); i++)
+				for (size_t j = 0; j < grid.tiles[i].size(); j++)
+					snapshot.alive[index++] = grid.tiles[i][j].isAlive;
+			snapshot.densityLevels = grid.densityLevels;
+			if (publishAges)
+				snapshot.ages = grid.ages;
+			missing.marks.assign(tiles, 0);
+			missing.full = false;
+		}
+		else
+		{
+			for (size_t index : missing.tiles)
+			{
+				missing.marks[index] = 0;
+				size_t i = index / rows, j = index % rows;
+				snapshot.alive[index] = grid.tiles[i][j].isAlive;
+				if (publishAges)
+					snapshot.ages[index] = grid.ages[index];
+				for (size_t l = 0; l < grid.densityLevels.size(); l++)
+				{
+					const DensityLevel& level = grid.densityLevels[l];
+					size_t block = (i / level.block) * level.rows + j / level.block;
+					snapshot.densityLevels[l].counts[block] = level.counts[block];
+				}
+			}
+		}
+		missing.tiles.clear();
+
+		if (!publishAges)
+			snapshot.ages.clear(); // nothing stale left for when they're switched back on
+		snapshot.dirty.assign(grid.dirtyTiles.begin(), grid.dirtyTiles.end());
+		grid.clearDirty();
+
+		snapshots.publish();
+
+		{
+			std::lock_guard<std::mutex> lock(publishMutex);
+			publishedSequence = sequence;
+		}
+		publishSignal.notify_all();
+	}
+};
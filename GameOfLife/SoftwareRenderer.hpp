@@ -0,0 +1,363 @@
+#pragma once
+#include "BitKernel.hpp"
+#include "CellAge.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// cpu only renderer for machines without a gpu or a display (thumbnails, movies of headless runs)
+// draws a bit-packed copy of the board into an rgb image using the same colors as the window
+// work is split into bands of output rows, one thread each, and the inner loops go a whole word
+// (64 cells) or byte (8 cells, through a lookup table of ready made pixels) at a time
+
+// how cells are colored, matches what the window shows
+enum class ColorMode
+{
+	Tiles, // alive / dead tile colors with the grid lines, averaged when several cells share a pixel
+	Density, // grey shade by live fraction like the window's zoomed-out view
+	Age // CellAge heatmap, needs the frame's ages
+};
+
+struct RasterOptions
+{
+	ColorMode colorMode = ColorMode::Tiles;
+	int cellPixels = 1; // each cell becomes cellPixels x cellPixels pixels
+	int cellsPerPixel = 1; // or each pixel covers cellsPerPixel x cellsPerPixel cells, for thumbnails
+	bool gridLines = true; // only drawn once cells are at least minGridLinePixels wide, like the window
+	int threads = 0; // 0 = one per hardware thread
+
+	static constexpr int minGridLinePixels = 4;
+};
+
+// 8 bit rgb, rows top to bottom with no padding
+struct Image
+{
+	int width = 0;
+	int height = 0;
+	std::vector<uint8_t> pixels;
+
+	uint8_t* row(int y)
+	{
+		return pixels.data() + static_cast<size_t>(y) * width * 3;
+	}
+};
+
+// bit-packed copy of (part of) a board, same layout as BitKernel: bit k of word n is cell n * 64 + k
+// copying one of these is cheap enough to do on the simulation thread, drawing it can happen anywhere
+struct BitFrame
+{
+	int width = 0;
+	int height = 0;
+	size_t stride = 0; // words per row
+	uint64_t generation = 0;
+	std::vector<uint64_t> words;
+	std::vector<uint8_t> ages; // width x height CellAge bytes, only filled for the age colors
+
+	void resize(int w, int h)
+	{
+		width = w;
+		height = h;
+		stride = BitKernel::wordsForWidth(w);
+		words.assign(stride * static_cast<size_t>(h), 0);
+	}
+
+	uint64_t* row(int y)
+	{
+		return words.data() + static_cast<size_t>(y) * stride;
+	}
+
+	const uint64_t* row(int y) const
+	{
+		return words.data() + static_cast<size_t>(y) * stride;
+	}
+
+	// from a backend that already stores bit-packed rows, rowOf(y) returns the row's words
+	template <typename RowOf>
+	void captureRows(int w, int h, RowOf rowOf)
+	{
+		if (w != width || h != height)
+			resize(w, h);
+		for (int y = 0; y < h; y++)
+			std::memcpy(row(y), rowOf(y), stride * sizeof(uint64_t));
+	}
+
+	// from anything that can answer isAlive(x, y)
+	template <typename IsAlive>
+	void captureCells(int w, int h, IsAlive isAlive)
+	{
+		resize(w, h);
+		for (int y = 0; y < h; y++)
+		{
+			uint64_t* words = row(y);
+			for (int x = 0; x < w; x++)
+				if (isAlive(x, y))
+					words[x >> 6] |= 1ull << (x & 63);
+		}
+	}
+
+	// ages from a backend with age rows, rowOf(y) returns the row's first byte
+	template <typename RowOf>
+	void captureAgeRows(int w, int h, RowOf rowOf)
+	{
+		ages.resize(static_cast<size_t>(w) * h);
+		for (int y = 0; y < h; y++)
+			std::memcpy(ages.data() + static_cast<size_t>(y) * w, rowOf(y), w);
+	}
+
+	template <typename AgeOf>
+	void captureAges(int w, int h, AgeOf ageOf)
+	{
+		ages.resize(static_cast<size_t>(w) * h);
+		for (int y = 0; y < h; y++)
+			for (int x = 0; x < w; x++)
+				ages[static_cast<size_t>(y) * w + x] = ageOf(x, y);
+	}
+};
+
+struct SoftwareRenderer
+{
+	// window colors after blending over the black background: alive tiles are white at 240 alpha, dead tiles
+	// black at 210 alpha, and the white grid lines show through that as a dim grey or pure white
+	static constexpr uint8_t aliveShade = 240;
+	static constexpr uint8_t deadShade = 0;
+	static constexpr uint8_t aliveLineShade = 255;
+	static constexpr uint8_t deadLineShade = 45;
+
+	RasterOptions options;
+	uint8_t byteLut[256][8 * 3]; // 8 cells -> 8 rgb pixels, for one pixel per cell
+
+	SoftwareRenderer(const RasterOptions& opts = RasterOptions()) : options(opts)
+	{
+		if (options.cellPixels < 1 || options.cellsPerPixel < 1 || (options.cellPixels > 1 && options.cellsPerPixel > 1))
+			throw std::invalid_argument("SoftwareRenderer: scale up or down, not both");
+
+		for (int bits = 0; bits < 256; bits++)
+			for (int c = 0; c < 8; c++)
+				std::memset(&byteLut[bits][c * 3], cellShade((bits >> c) & 1), 3);
+	}
+
+	uint8_t cellShade(bool alive) const
+	{
+		if (options.colorMode == ColorMode::Density)
+			return alive ? 255 : 0;
+		return alive ? aliveShade : deadShade;
+	}
+
+	bool drawsLines() const
+	{
+		return options.colorMode == ColorMode::Tiles && options.gridLines && options.cellPixels >= RasterOptions::minGridLinePixels;
+	}
+
+	int imageWidth(const BitFrame& frame) const
+	{
+		return options.cellsPerPixel > 1 ? (frame.width + options.cellsPerPixel - 1) / options.cellsPerPixel : frame.width * options.cellPixels;
+	}
+
+	int imageHeight(const BitFrame& frame) const
+	{
+		return options.cellsPerPixel > 1 ? (frame.height + options.cellsPerPixel - 1) / options.cellsPerPixel : frame.height * options.cellPixels;
+	}
+
+	void render(const BitFrame& frame, Image& image)
+	{
+		image.width = imageWidth(frame);
+		image.height = imageHeight(frame);
+		image.pixels.resize(static_cast<size_t>(image.width) * image.height * 3);
+		if (image.width == 0 || image.height == 0) return;
+		if (options.colorMode == ColorMode::Age && frame.ages.size() != static_cast<size_t>(frame.width) * frame.height)
+			throw std::invalid_argument("SoftwareRenderer: the age colors need the frame's cell ages");
+
+		// bands of whole cell rows (or whole pixel rows when scaling down) so no two threads share a row
+		int units = options.cellsPerPixel > 1 ? image.height : frame.height;
+		int threads = options.threads > 0 ? options.threads : static_cast<int>(std::thread::hardware_concurrency());
+		if (threads < 1) threads = 1;
+		if (threads > units) threads = units;
+
+		std::vector<std::thread> workers;
+		for (int t = 1; t < threads; t++)
+		{
+			int begin = static_cast<int>(static_cast<int64_t>(units) * t / threads);
+			int end = static_cast<int>(static_cast<int64_t>(units) * (t + 1) / threads);
+			workers.emplace_back([this, &frame, &image, begin, end] { renderBand(frame, image, begin, end); });
+		}
+		renderBand(frame, image, 0, static_cast<int>(static_cast<int64_t>(units) / threads));
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+
+	void renderBand(const BitFrame& frame, Image& image, int begin, int end)
+	{
+		if (options.colorMode == ColorMode::Age)
+			ageRows(frame, image, begin, end);
+		else if (options.cellsPerPixel > 1)
+			downsampleRows(frame, image, begin, end);
+		else
+			expandRows(frame, image, begin, end);
+	}
+
+	// one or more pixels per cell, [begin, end) are cell rows
+	void expandRows(const BitFrame& frame, Image& image, int begin, int end)
+	{
+		int scale = options.cellPixels;
+		bool lines = drawsLines();
+		size_t rowBytes = static_cast<size_t>(image.width) * 3;
+
+		for (int y = begin; y < end; y++)
+		{
+			const uint64_t* words = frame.row(y);
+			uint8_t* first = image.row(y * scale);
+
+			if (scale == 1)
+			{
+				int x = 0;
+				for (; x + 8 <= frame.width; x += 8)
+					std::memcpy(first + x * 3, byteLut[(words[x >> 6] >> (x & 63)) & 0xff], 8 * 3);
+				for (; x < frame.width; x++)
+					std::memset(first + x * 3, cellShade(BitKernel::getBit(words, x)), 3);
+				continue;
+			}
+
+			// the inside rows of this cell row, then the top one which is the grid line when there are lines
+			uint8_t* inside = image.row(y * scale + 1);
+			for (int x = 0; x < frame.width; x++)
+			{
+				bool alive = BitKernel::getBit(words, x);
+				uint8_t* pixel = inside + static_cast<size_t>(x) * scale * 3;
+				std::memset(pixel, cellShade(alive), static_cast<size_t>(scale) * 3);
+				if (lines)
+					std::memset(pixel, alive ? aliveLineShade : deadLineShade, 3);
+			}
+			for (int r = 2; r < scale; r++)
+				std::memcpy(image.row(y * scale + r), inside, rowBytes);
+
+			if (!lines)
+			{
+				std::memcpy(first, inside, rowBytes);
+				continue;
+			}
+			for (int x = 0; x < frame.width; x++)
+				std::memset(first + static_cast<size_t>(x) * scale * 3, BitKernel::getBit(words, x) ? aliveLineShade : deadLineShade, static_cast<size_t>(scale) * 3);
+		}
+	}
+
+	// heatmap through the CellAge palette, no grid lines, averaged when several cells share a pixel
+	// [begin, end) are cell rows when scaling up and pixel rows when scaling down, like the other two
+	void ageRows(const BitFrame& frame, Image& image, int begin, int end)
+	{
+		const CellAge::Palette& palette = CellAge::Palette::get();
+
+		if (options.cellsPerPixel == 1)
+		{
+			int scale = options.cellPixels;
+			size_t rowBytes = static_cast<size_t>(image.width) * 3;
+			for (int y = begin; y < end; y++)
+			{
+				const uint64_t* words = frame.row(y);
+				const uint8_t* ages = frame.ages.data() + static_cast<size_t>(y) * frame.width;
+				uint8_t* first = image.row(y * scale);
+				for (int x = 0; x < frame.width; x++)
+				{
+					const uint8_t* color = palette.color(BitKernel::getBit(words, x), ages[x]);
+					uint8_t* pixel = first + static_cast<size_t>(x) * scale * 3;
+					for (int r = 0; r < scale; r++, pixel += 3)
+						std::memcpy(pixel, color, 3);
+				}
+				for (int r = 1; r < scale; r++)
+					std::memcpy(image.row(y * scale + r), first, rowBytes);
+			}
+			return;
+		}
+
+		int k = options.cellsPerPixel;
+		std::vector<uint32_t> sums(static_cast<size_t>(image.width) * 3);
+		for (int py = begin; py < end; py++)
+		{
+			int y0 = py * k;
+			int y1 = y0 + k < frame.height ? y0 + k : frame.height;
+
+			std::fill(sums.begin(), sums.end(), 0);
+			for (int y = y0; y < y1; y++)
+			{
+				const uint64_t* words = frame.row(y);
+				const uint8_t* ages = frame.ages.data() + static_cast<size_t>(y) * frame.width;
+				for (int x = 0; x < frame.width; x++)
+				{
+					const uint8_t* color = palette.color(BitKernel::getBit(words, x), ages[x]);
+					uint32_t* sum = &sums[static_cast<size_t>(x / k) * 3];
+					sum[0] += color[0];
+					sum[1] += color[1];
+					sum[2] += color[2];
+				}
+			}
+
+			uint8_t* out = image.row(py);
+			for (int px = 0; px < image.width; px++)
+			{
+				int x0 = px * k;
+				uint32_t cells = static_cast<uint32_t>((x0 + k < frame.width ? k : frame.width - x0) * (y1 - y0));
+				for (int c = 0; c < 3; c++)
+					out[px * 3 + c] = static_cast<uint8_t>(sums[static_cast<size_t>(px) * 3 + c] / cells);
+			}
+		}
+	}
+
+	// live cells among bits [x0, x0 + count) of a row, whole words at a time
+	static uint32_t countRange(const uint64_t* words, int x0, int count)
+	{
+		uint32_t total = 0;
+		int x = x0;
+		int end = x0 + count;
+		while (x < end)
+		{
+			int bit = x & 63;
+			int take = 64 - bit < end - x ? 64 - bit : end - x;
+			uint64_t mask = take == 64 ? ~0ull : ((1ull << take) - 1) << bit;
+			total += BitKernel::popcount(words[x >> 6] & mask);
+			x += take;
+		}
+		return total;
+	}
+
+	// several cells per pixel, [begin, end) are pixel rows
+	void downsampleRows(const BitFrame& frame, Image& image, int begin, int end)
+	{
+		int k = options.cellsPerPixel;
+		std::vector<uint32_t> counts(image.width);
+
+		for (int py = begin; py < end; py++)
+		{
+			int y0 = py * k;
+			int y1 = y0 + k < frame.height ? y0 + k : frame.height;
+
+			std::fill(counts.begin(), counts.end(), 0);
+			for (int y = y0; y < y1; y++)
+			{
+				const uint64_t* words = frame.row(y);
+				for (int px = 0; px < image.width; px++)
+				{
+					int x0 = px * k;
+					int cells = x0 + k < frame.width ? k : frame.width - x0;
+					counts[px] += countRange(words, x0, cells);
+				}
+			}
+
+			uint8_t* out = image.row(py);
+			for (int px = 0; px < image.width; px++)
+			{
+				int x0 = px * k;
+				int cells = (x0 + k < frame.width ? k : frame.width - x0) * (y1 - y0);
+				float fraction = static_cast<float>(counts[px]) / cells;
+
+				uint8_t shade;
+				if (options.colorMode == ColorMode::Density)
+					shade = static_cast<uint8_t>(255.f * (fraction * 2.f < 1.f ? fraction * 2.f : 1.f));
+				else
+					shade = static_cast<uint8_t>(deadShade + (aliveShade - deadShade) * fraction);
+				std::memset(out + static_cast<size_t>(px) * 3, shade, 3);
+			}
+		}
+	}
+};
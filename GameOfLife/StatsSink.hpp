@@ -0,0 +1,210 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// per-generation statistics streamed to a file while the run goes on
+// the simulation thread pushes a small record per generation into a single producer / single consumer
+// ring (two atomics, no locks, no allocation) and a writer thread drains it in batches, formats them and
+// writes them out, so the step loop never waits on the file
+// a full ring means the writer can't keep up, the simulation then waits for a slot rather than losing
+// generations (and counts how often that happened)
+// csv with a header line, or json lines when the file ends in .jsonl / .json
+
+struct GenerationStats
+{
+	uint64_t generation;
+	uint64_t population;
+	uint64_t births;
+	uint64_t deaths;
+	int64_t minX; // bounding box of the live cells, min > max for an empty board
+	int64_t minY;
+	int64_t maxX;
+	int64_t maxY;
+	double stepSeconds;
+};
+
+// capacity is rounded up to a power of two, one slot stays empty to tell full from empty
+template <typename T>
+struct SpscRing
+{
+	std::vector<T> slots;
+	size_t mask;
+	alignas(64) std::atomic<size_t> head{ 0 }; // next slot to read, only the consumer moves it
+	alignas(64) std::atomic<size_t> tail{ 0 }; // next slot to write, only the producer moves it
+
+	SpscRing(size_t capacity)
+	{
+		size_t size = 2;
+		while (size < capacity + 1)
+			size <<= 1;
+		slots.resize(size);
+		mask = size - 1;
+	}
+
+	// producer
+	bool push(const T& item)
+	{
+		size_t at = tail.load(std::memory_order_relaxed);
+		if (((at + 1) & mask) == head.load(std::memory_order_acquire))
+			return false;
+		slots[at] = item;
+		tail.store((at + 1) & mask, std::memory_order_release);
+		return true;
+	}
+
+	// consumer, takes up to max items, returns how many
+	size_t pop(T* out, size_t max)
+	{
+		size_t at = head.load(std::memory_order_relaxed);
+		size_t end = tail.load(std::memory_order_acquire);
+		size_t count = 0;
+		while (at != end && count < max)
+		{
+			out[count++] = slots[at];
+			at = (at + 1) & mask;
+		}
+		head.store(at, std::memory_order_release);
+		return count;
+	}
+};
+
+struct StatsSink
+{
+	static constexpr size_t ringRecords = 1 << 16;
+	static constexpr size_t batchRecords = 4096;
+
+	std::string path;
+	bool json;
+	std::FILE* file = nullptr;
+
+	SpscRing<GenerationStats> ring;
+	std::thread writer;
+	std::atomic<bool> finishing{ false };
+	std::atomic<bool> failed{ false };
+	uint64_t stalls = 0; // pushes that found the ring full
+	uint64_t recordsWritten = 0;
+	uint64_t bytesWritten = 0;
+
+	StatsSink(const std::string& filePath) : path(filePath), json(endsWith(filePath, ".jsonl") || endsWith(filePath, ".json")), ring(ringRecords)
+	{
+		file = std::fopen(path.c_str(), "wb");
+		if (!file)
+			throw std::runtime_error("StatsSink: can't write " + path);
+		if (!json)
+			write("generation,population,births,deaths,min_x,min_y,max_x,max_y,step_seconds\n");
+		writer = std::thread(&StatsSink::writerLoop, this);
+	}
+
+	~StatsSink()
+	{
+		try
+		{
+			finish();
+		}
+		catch (const std::exception&)
+		{
+			// nowhere to report it from a destructor, call finish() first to find out
+		}
+	}
+
+	StatsSink(const StatsSink&) = delete;
+	StatsSink& operator=(const StatsSink&) = delete;
+
+	static bool endsWith(const std::string& text, const std::string& suffix)
+	{
+		return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	// simulation thread
+	void push(const GenerationStats& record)
+	{
+		if (ring.push(record)) return;
+		stalls++;
+		while (!ring.push(record))
+		{
+			if (failed) throw std::runtime_error("StatsSink: writing " + path + " failed");
+			std::this_thread::yield();
+		}
+	}
+
+	// writes whatever is left and closes the file, throws if anything failed
+	void finish()
+	{
+		if (!file) return;
+		finishing = true;
+		if (writer.joinable())
+			writer.join();
+		bool closed = std::fclose(file) == 0;
+		file = nullptr;
+		if (failed || !closed)
+			throw std::runtime_error("StatsSink: writing " + path + " failed");
+	}
+
+	void write(const std::string& text)
+	{
+		if (std::fwrite(text.data(), 1, text.size(), file) != text.size())
+			failed = true;
+		bytesWritten += text.size();
+	}
+
+	void writerLoop()
+	{
+		std::vector<GenerationStats> batch(batchRecords);
+		std::string text;
+		while (true)
+		{
+			// read finishing before draining, anything pushed before it was set is in this pop or a later one
+			bool last = finishing;
+			size_t count = ring.pop(batch.data(), batch.size());
+			if (count == 0)
+			{
+				if (last) break;
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+
+			text.clear();
+			for (size_t n = 0; n < count; n++)
+				format(batch[n], text);
+			if (!failed)
+				write(text);
+			recordsWritten += count;
+		}
+		std::fflush(file);
+	}
+
+	void format(const GenerationStats& record, std::string& text) const
+	{
+		char line[320];
+		bool empty = record.minX > record.maxX;
+		if (json)
+		{
+			char box[160];
+			if (empty)
+				std::snprintf(box, sizeof(box), "null");
+			else
+				std::snprintf(box, sizeof(box), "[%lld,%lld,%lld,%lld]", static_cast<long long>(record.minX), static_cast<long long>(record.minY),
+					static_cast<long long>(record.maxX), static_cast<long long>(record.maxY));
+			std::snprintf(line, sizeof(line), "{\"generation\":%llu,\"population\":%llu,\"births\":%llu,\"deaths\":%llu,\"bbox\":%s,\"step_seconds\":%.9g}\n",
+				static_cast<unsigned long long>(record.generation), static_cast<unsigned long long>(record.population),
+				static_cast<unsigned long long>(record.births), static_cast<unsigned long long>(record.deaths), box, record.stepSeconds);
+		}
+		else
+		{
+			char box[160] = ",,,";
+			if (!empty)
+				std::snprintf(box, sizeof(box), "%lld,%lld,%lld,%lld", static_cast<long long>(record.minX), static_cast<long long>(record.minY),
+					static_cast<long long>(record.maxX), static_cast<long long>(record.maxY));
+			std::snprintf(line, sizeof(line), "%llu,%llu,%llu,%llu,%s,%.9g\n",
+				static_cast<unsigned long long>(record.generation), static_cast<unsigned long long>(record.population),
+				static_cast<unsigned long long>(record.births), static_cast<unsigned long long>(record.deaths), box, record.stepSeconds);
+		}
+		text += line;
+	}
+};
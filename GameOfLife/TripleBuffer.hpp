@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// lock-free single writer / single reader triple buffer
+// the writer fills writeBuffer() and publish()es it, the reader calls update() and then reads readBuffer()
+// neither side ever waits: the writer always has a buffer of its own, and the reader always gets the newest
+// published one, anything published in between is simply skipped
+
+template <typename T>
+struct TripleBuffer
+{
+	static constexpr uint8_t indexMask = 3;
+	static constexpr uint8_t freshBit = 4; // set when the middle buffer hasn't been picked up by the reader yet
+
+	T buffers[3];
+	std::atomic<uint8_t> middle{ 1 };
+	uint8_t back = 0; // owned by the writer
+	uint8_t front = 2; // owned by the reader
+
+	T& writeBuffer()
+	{
+		return buffers[back];
+	}
+
+	void publish()
+	{
+		back = middle.exchange(static_cast<uint8_t>(back | freshBit), std::memory_order_acq_rel) & indexMask;
+	}
+
+	// swaps in the newest published buffer, returns false if nothing new was published since last time
+	bool update()
+	{
+		if (!(middle.load(std::memory_order_acquire) & freshBit))
+			return false;
+		front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+		return true;
+	}
+
+	const T& readBuffer() const
+	{
+		return buffers[front];
+	}
+};
@@ -0,0 +1,155 @@
+#pragma once
+#include "History.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// undo and redo for the edits made in the window
+// a step is the set of tiles an edit flipped (index i * rows + j like Grid's dirty list), sorted and coded
+// as runs: varint gap since the end of the last run, varint run length
+// a click is a couple of bytes and placing a pattern costs about as much as the pattern itself, the board
+// is never copied
+// undoing and redoing both flip the same tiles again, so either one costs as much as the edit did
+// steps remember the generation they were made at, the oldest are dropped to stay under the memory budget
+
+struct UndoHistory
+{
+	struct Step
+	{
+		uint64_t generation = 0;
+		uint64_t tiles = 0;
+		std::vector<uint8_t> runs;
+	};
+
+	size_t memoryBudget;
+	std::deque<Step> undoSteps; // oldest first
+	std::vector<Step> redoSteps; // the next one to redo last
+	size_t bytes = 0;
+
+	UndoHistory(size_t budget) : memoryBudget(budget)
+	{
+	}
+
+	// an edit made at generation that flipped these tiles (sorted here), anything undone is gone for good
+	void record(uint64_t generation, std::vector<size_t>& flipped)
+	{
+		if (flipped.empty()) return;
+		std::sort(flipped.begin(), flipped.end());
+		flipped.erase(std::unique(flipped.begin(), flipped.end()), flipped.end());
+
+		Step step;
+		step.generation = generation;
+		step.tiles = flipped.size();
+		size_t end = 0; // just past the last run
+		for (size_t n = 0; n < flipped.size();)
+		{
+			size_t length = 1;
+			while (n + length < flipped.size() && flipped[n + length] == flipped[n] + length)
+				length++;
+			History::putVarint(step.runs, flipped[n] - end);
+			History::putVarint(step.runs, length);
+			end = flipped[n] + length;
+			n += length;
+		}
+		step.runs.shrink_to_fit();
+
+		clearRedo();
+		bytes += stepBytes(step);
+		undoSteps.push_back(std::move(step));
+		while (bytes > memoryBudget && !undoSteps.empty())
+		{
+			bytes -= stepBytes(undoSteps.front());
+			undoSteps.pop_front();
+		}
+	}
+
+	bool canUndo() const
+	{
+		return !undoSteps.empty();
+	}
+
+	bool canRedo() const
+	{
+		return !redoSteps.empty();
+	}
+
+	// generation the next undo / redo was made at
+	uint64_t undoGeneration() const
+	{
+		return undoSteps.back().generation;
+	}
+
+	uint64_t redoGeneration() const
+	{
+		return redoSteps.back().generation;
+	}
+
+	// flip(index) for every tile of the step to undo, which then waits to be redone
+	template <typename Flip>
+	void undo(Flip flip)
+	{
+		forEachTile(undoSteps.back(), flip);
+		redoSteps.push_back(std::move(undoSteps.back()));
+		undoSteps.pop_back();
+	}
+
+	template <typename Flip>
+	void redo(Flip flip)
+	{
+		forEachTile(redoSteps.back(), flip);
+		undoSteps.push_back(std::move(redoSteps.back()));
+		redoSteps.pop_back();
+	}
+
+	// the board went back to before generation, edits made after that aren't on it anymore
+	void dropAfter(uint64_t generation)
+	{
+		while (!undoSteps.empty() && undoSteps.back().generation > generation)
+		{
+			bytes -= stepBytes(undoSteps.back());
+			undoSteps.pop_back();
+		}
+		// undone newest first, so the redo steps are the other way around
+		while (!redoSteps.empty() && redoSteps.front().generation > generation)
+		{
+			bytes -= stepBytes(redoSteps.front());
+			redoSteps.erase(redoSteps.begin());
+		}
+	}
+
+	void clear()
+	{
+		undoSteps.clear();
+		redoSteps.clear();
+		bytes = 0;
+	}
+
+	void clearRedo()
+	{
+		for (const Step& step : redoSteps)
+			bytes -= stepBytes(step);
+		redoSteps.clear();
+	}
+
+	template <typename Flip>
+	static void forEachTile(const Step& step, Flip flip)
+	{
+		const uint8_t* data = step.runs.data();
+		const uint8_t* end = data + step.runs.size();
+		size_t index = 0;
+		while (data != end)
+		{
+			index += static_cast<size_t>(History::getVarint(data, end));
+			size_t length = static_cast<size_t>(History::getVarint(data, end));
+			for (size_t k = 0; k < length; k++)
+				flip(index + k);
+			index += length;
+		}
+	}
+
+	static size_t stepBytes(const Step& step)
+	{
+		return sizeof(Step) + step.runs.capacity();
+	}
+};
@@ -1,9 +1,52 @@
-#include "Game.hpp"
+#include "RunOptions.hpp"
+#include "Headless.hpp"
 #include "Constants.hpp"
+#include <exception>
+#include <iostream>
+
+// GOL_HEADLESS_ONLY builds the batch runner on its own, without sfml (see build-headless.sh)
+#ifndef GOL_HEADLESS_ONLY
+#include "Game.hpp"
+#endif
 
-int main()
+int main(int argc, char** argv)
 {
-    sf::RenderWindow window(sf::VideoMode(gameWidth, gameHeight), "GameOfLife");
-    
-    Game game(window);
+    RunOptions options;
+    try
+    {
+        options = parseRunOptions(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << "\n\n" << usageText();
+        return 1;
+    }
+
+    if (options.help)
+    {
+        std::cout << usageText();
+        return 0;
+    }
+
+#ifdef GOL_HEADLESS_ONLY
+    options.headless = true;
+#endif
+
+    try
+    {
+        if (options.headless)
+            return runHeadless(options);
+
+#ifndef GOL_HEADLESS_ONLY
+        sf::RenderWindow window(sf::VideoMode(gameWidth, gameHeight), "GameOfLife");
+
+        Game game(window, options);
+#endif
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,15 @@
+#!/bin/sh
+# Builds the windowless batch runner (GameOfLife --headless) for Linux / macOS servers.
+# Only needs a C++17 compiler, SFML isn't used or linked.
+
+cd "$(dirname "$0")" || exit 1
+
+CXX="${CXX:-c++}"
+mkdir -p x64/Headless
+
+"$CXX" -std=c++17 -O2 -pthread -DGOL_HEADLESS_ONLY -I"GameOfLife" "GameOfLife/main.cpp" -o "x64/Headless/GameOfLife" || {
+    echo "Build failed!"
+    exit 1
+}
+
+echo "Build successful!"